@@ -0,0 +1,150 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef ACKBATCH_H_DEFINED
+#define ACKBATCH_H_DEFINED
+
+#include "UDPEventsProtocol.h"
+#include "UDPUtils.h"
+
+/**
+ * Collect acks while parsing a batch of received messages, then send them all at once.
+ *
+ * Buffers are allocated inline, once, so adding and sending acks doesn't allocate.
+ */
+class AckBatch
+{
+public:
+    AckBatch()
+    {
+        for (int i = 0; i < UDP_MAX_BATCH_SIZE; i++)
+        {
+            outgoing[i].buffer = buffers[i];
+            outgoing[i].bufferLength = 0;
+            outgoing[i].bytesRead = 0;
+        }
+    }
+
+    /** Forget acks from the previous batch. */
+    void clear()
+    {
+        pending = 0;
+    }
+
+    /** Decide whether and how to ack one message, according to the ack mode. */
+    void add(UDPEventsAckMode mode, const struct UdpAddress &address, uint8_t typeByte, int64_t receiveNanos, double clientSeconds)
+    {
+        switch (mode)
+        {
+        case ACK_PER_MESSAGE:
+            append(address, receiveNanos, clientSeconds, false);
+            break;
+        case ACK_COALESCED:
+            coalesce(address, receiveNanos, clientSeconds);
+            break;
+        case ACK_ON_REQUEST:
+            if (typeByte & UDP_EVENTS_FLAG_ACK_REQUESTED)
+            {
+                append(address, receiveNanos, clientSeconds, true);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    /** Send all pending acks with the given flags, return the number sent or negative on error. */
+    int send(int s, uint8_t flags = 0)
+    {
+        if (pending == 0)
+        {
+            return 0;
+        }
+        for (int i = 0; i < pending; i++)
+        {
+            acks[i].flags = flags;
+            outgoing[i].bufferLength = extended[i] ? acks[i].packExtended(buffers[i]) : acks[i].packLegacy(buffers[i]);
+        }
+        int sent = udpSendBatch(s, outgoing, pending);
+        pending = 0;
+        return sent;
+    }
+
+    /** How many waiting acks are extended acks, which can carry flags. */
+    int extendedCount() const
+    {
+        int count = 0;
+        for (int i = 0; i < pending; i++)
+        {
+            count += extended[i] ? 1 : 0;
+        }
+        return count;
+    }
+
+    /** How many acks are waiting to be sent. */
+    int size() const
+    {
+        return pending;
+    }
+
+private:
+    void append(const struct UdpAddress &address, int64_t receiveNanos, double clientSeconds, bool isExtended)
+    {
+        if (pending >= UDP_MAX_BATCH_SIZE)
+        {
+            return;
+        }
+        outgoing[pending].address = address;
+        acks[pending].serverMillis = receiveNanos / 1000000;
+        acks[pending].receiveNanos = receiveNanos;
+        acks[pending].clientSeconds = clientSeconds;
+        acks[pending].messageCount = 1;
+        extended[pending] = isExtended;
+        pending++;
+    }
+
+    void coalesce(const struct UdpAddress &address, int64_t receiveNanos, double clientSeconds)
+    {
+        // Batches are small, so a linear search for the client is fine.
+        for (int i = 0; i < pending; i++)
+        {
+            if (outgoing[i].address.host == address.host && outgoing[i].address.port == address.port)
+            {
+                acks[i].serverMillis = receiveNanos / 1000000;
+                acks[i].receiveNanos = receiveNanos;
+                acks[i].clientSeconds = clientSeconds;
+                acks[i].messageCount++;
+                return;
+            }
+        }
+        append(address, receiveNanos, clientSeconds, true);
+    }
+
+    struct UdpMessage outgoing[UDP_MAX_BATCH_SIZE];
+    UDPEventsAck acks[UDP_MAX_BATCH_SIZE];
+    bool extended[UDP_MAX_BATCH_SIZE];
+    char buffers[UDP_MAX_BATCH_SIZE][UDP_EVENTS_EXTENDED_ACK_LENGTH];
+    int pending = 0;
+};
+
+#endif
@@ -0,0 +1,256 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef CLOCKMODEL_H_DEFINED
+#define CLOCKMODEL_H_DEFINED
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Fit a line from client soft seconds to local sample numbers, over a sliding window of recent sync pairs.
+ *
+ * The fit has an offset and a rate, so it can follow drift between the client clock and the sample clock.
+ * Each new pair updates running means and co-moments in O(1), and the oldest pair in the window is removed the same way.
+ * To keep rounding error from piling up, the fit is recomputed from the window once per window's worth of pairs.
+ *
+ * New pairs that are far from the current fit are rejected as outliers.
+ * If several pairs in a row are rejected the client clock probably jumped, so the fit starts over from the latest pair.
+ */
+class ClockModel
+{
+public:
+    /** Choose how many recent pairs to fit, and how far off a pair must be to count as an outlier.  Also clears the fit. */
+    void configure(size_t newWindowSize, double newOutlierThreshold)
+    {
+        windowSize = newWindowSize < 2 ? 2 : newWindowSize;
+        outlierThreshold = newOutlierThreshold;
+        window.assign(windowSize, Pair());
+        reset();
+    }
+
+    /** Forget all pairs and start a new fit. */
+    void reset()
+    {
+        pairCount = 0;
+        nextSlot = 0;
+        addsSinceRecompute = 0;
+        meanX = 0.0;
+        meanY = 0.0;
+        comomentXX = 0.0;
+        comomentXY = 0.0;
+        residualVariance = 0.0;
+        consecutiveRejects = 0;
+    }
+
+    /** Add a sync pair, return false if the pair was rejected as an outlier.  Pass the nominal sample rate for when there's too little data to fit a rate. */
+    bool addPair(double softSecs, int64_t sampleNumber, double nominalRate)
+    {
+        if (window.empty())
+        {
+            configure(windowSize, outlierThreshold);
+        }
+        nominalSampleRate = nominalRate;
+
+        if (pairCount == 0)
+        {
+            // Measure relative to the first pair, to keep magnitudes small.
+            originSecs = softSecs;
+            originSample = sampleNumber;
+        }
+
+        const double x = softSecs - originSecs;
+        const double y = (double)(sampleNumber - originSample);
+
+        if (pairCount >= MIN_PAIRS_FOR_OUTLIERS)
+        {
+            const double residual = y - predictRelative(x);
+            const double floor = OUTLIER_FLOOR_SECONDS * nominalSampleRate;
+            const double limit = std::fmax(outlierThreshold * std::sqrt(residualVariance), floor);
+            if (std::fabs(residual) > limit)
+            {
+                if (++consecutiveRejects < MAX_CONSECUTIVE_REJECTS)
+                {
+                    return false;
+                }
+
+                // Too many rejects in a row -- more likely the clock jumped than the pairs are all bad.
+                reset();
+                return addPair(softSecs, sampleNumber, nominalRate);
+            }
+
+            // Track typical prediction error, which is the scale for outlier rejection.
+            residualVariance += (residual * residual - residualVariance) / (double)windowSize;
+        }
+        consecutiveRejects = 0;
+
+        if (pairCount == windowSize)
+        {
+            removeFromFit(window[nextSlot]);
+        }
+        window[nextSlot] = {x, y};
+        nextSlot = (nextSlot + 1) % windowSize;
+        addToFit(x, y);
+
+        if (++addsSinceRecompute >= windowSize)
+        {
+            recompute();
+        }
+        return true;
+    }
+
+    /** Whether any pairs have been accepted, so predictions make sense. */
+    bool hasFit() const
+    {
+        return pairCount > 0;
+    }
+
+    /** How many pairs are in the current fit. */
+    size_t size() const
+    {
+        return pairCount;
+    }
+
+    /** Fitted local samples per client second, or the nominal sample rate if there's not enough spread in the pairs yet. */
+    double samplesPerSecond() const
+    {
+        if (pairCount >= 2 && comomentXX >= MIN_SPREAD_SECONDS_SQUARED)
+        {
+            return comomentXY / comomentXX;
+        }
+        return nominalSampleRate;
+    }
+
+    /** Fitted (fractional) local sample number for the given client soft seconds. */
+    double predict(double softSecs) const
+    {
+        return (double)originSample + predictRelative(softSecs - originSecs);
+    }
+
+    /** Typical size of the difference between new pairs and the fit, in samples. */
+    double residualRms() const
+    {
+        return std::sqrt(residualVariance);
+    }
+
+private:
+    struct Pair
+    {
+        double x = 0.0;
+        double y = 0.0;
+    };
+
+    /** Don't judge outliers until there are enough pairs to trust the fit. */
+    static const size_t MIN_PAIRS_FOR_OUTLIERS = 4;
+
+    /** Start over after this many outliers in a row. */
+    static const int MAX_CONSECUTIVE_REJECTS = 3;
+
+    /** Never reject pairs within this much of the fit, even if the fit has been very tight so far. */
+    static constexpr double OUTLIER_FLOOR_SECONDS = 0.001;
+
+    /** Pairs this close together in time (as summed squared deviation) can't tell us the rate. */
+    static constexpr double MIN_SPREAD_SECONDS_SQUARED = 1.0;
+
+    double predictRelative(double x) const
+    {
+        const double rate = samplesPerSecond();
+        return meanY + rate * (x - meanX);
+    }
+
+    void addToFit(double x, double y)
+    {
+        pairCount++;
+        const double dx = x - meanX;
+        meanX += dx / (double)pairCount;
+        meanY += (y - meanY) / (double)pairCount;
+        comomentXX += dx * (x - meanX);
+        comomentXY += dx * (y - meanY);
+    }
+
+    void removeFromFit(const Pair &pair)
+    {
+        if (pairCount <= 1)
+        {
+            pairCount = 0;
+            meanX = 0.0;
+            meanY = 0.0;
+            comomentXX = 0.0;
+            comomentXY = 0.0;
+            return;
+        }
+        pairCount--;
+        const double dx = pair.x - meanX;
+        meanX -= dx / (double)pairCount;
+        meanY -= (pair.y - meanY) / (double)pairCount;
+        comomentXX -= dx * (pair.x - meanX);
+        comomentXY -= dx * (pair.y - meanY);
+    }
+
+    /** Two-pass fit over the whole window, to clear out accumulated rounding error. */
+    void recompute()
+    {
+        addsSinceRecompute = 0;
+        double sumX = 0.0;
+        double sumY = 0.0;
+        for (size_t i = 0; i < pairCount; i++)
+        {
+            const Pair &pair = window[(nextSlot + windowSize - pairCount + i) % windowSize];
+            sumX += pair.x;
+            sumY += pair.y;
+        }
+        meanX = sumX / (double)pairCount;
+        meanY = sumY / (double)pairCount;
+        comomentXX = 0.0;
+        comomentXY = 0.0;
+        for (size_t i = 0; i < pairCount; i++)
+        {
+            const Pair &pair = window[(nextSlot + windowSize - pairCount + i) % windowSize];
+            comomentXX += (pair.x - meanX) * (pair.x - meanX);
+            comomentXY += (pair.x - meanX) * (pair.y - meanY);
+        }
+    }
+
+    size_t windowSize = 16;
+    double outlierThreshold = 5.0;
+    std::vector<Pair> window;
+    size_t pairCount = 0;
+    size_t nextSlot = 0;
+    size_t addsSinceRecompute = 0;
+
+    double originSecs = 0.0;
+    int64_t originSample = 0;
+    double nominalSampleRate = 0.0;
+
+    double meanX = 0.0;
+    double meanY = 0.0;
+    double comomentXX = 0.0;
+    double comomentXY = 0.0;
+
+    double residualVariance = 0.0;
+    int consecutiveRejects = 0;
+};
+
+#endif
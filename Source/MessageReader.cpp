@@ -0,0 +1,280 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "MessageReader.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "UDPEventsLog.h"
+
+MessageReader::MessageReader(uint8_t index, UDPEventsAckMode ackMode, SpscRing<SoftEvent> &queue, TextArena &text, UDPEventsStats &stats, UDPEventsLatency &latency)
+    : ackMode(ackMode), parser(index, queue, text, stats), queue(queue), backpressureDepth(queue.maxItems() / 2), stats(stats), latency(latency)
+{
+    std::memset(batch, 0, sizeof(batch));
+}
+
+MessageReader::~MessageReader()
+{
+    udpCloseReceiveRing(ring);
+}
+
+void MessageReader::useBatchBuffers()
+{
+    batchBuffers.resize(UDP_MAX_BATCH_SIZE * UDP_MAX_MESSAGE_LENGTH);
+    for (int i = 0; i < UDP_MAX_BATCH_SIZE; i++)
+    {
+        batch[i].buffer = batchBuffers.data() + i * UDP_MAX_MESSAGE_LENGTH;
+        batch[i].bufferLength = UDP_MAX_MESSAGE_LENGTH;
+        batch[i].bytesRead = 0;
+        batch[i].truncated = false;
+    }
+}
+
+bool MessageReader::prepare(int s, bool allowRing)
+{
+    serverSocket = s;
+    lastKernelDropCount = 0;
+
+    // Ask the kernel to tell us about messages it drops when the socket buffer is full, which we'd otherwise never see.
+    // Where that's not supported, kernel drops just stay at 0.
+    udpEnableDropCounts(serverSocket);
+
+    // Receive into the ring's pooled buffers where we can, or else our own.
+    udpCloseReceiveRing(ring);
+    ring = allowRing ? udpOpenReceiveRing(serverSocket) : nullptr;
+    if (ring == nullptr)
+    {
+        useBatchBuffers();
+    }
+
+    // Sleep on the socket, or the ring, and a wakeup signal together.  Where that doesn't work, fall back to polling, see canWake().
+    // No other thread can wake() us yet, so this is the one place to close and reopen the wait set.
+    waitSetUsable = waitSet.open() && waitSet.add(ring != nullptr ? udpReceiveRingHandle(ring) : serverSocket);
+    if (!waitSetUsable)
+    {
+        waitSet.close();
+        stopUsingRing();
+    }
+
+    // Ask the kernel to timestamp messages as they arrive, which is more precise than checking the clock after we wake up.
+    return udpEnableReceiveTimestamps(serverSocket) >= 0;
+}
+
+void MessageReader::stopUsingRing()
+{
+    if (ring == nullptr)
+    {
+        return;
+    }
+    udpCloseReceiveRing(ring);
+    ring = nullptr;
+    useBatchBuffers();
+
+    // The ring closed, so the wait set dropped it and needs the socket instead.
+    // If that fails, leave the wait set open for wake() from other threads, and poll instead.
+    if (waitSetUsable && !waitSet.add(serverSocket))
+    {
+        waitSetUsable = false;
+    }
+}
+
+const char *MessageReader::getReceiveBuffers(size_t &bytes) const
+{
+    if (ring != nullptr)
+    {
+        return udpReceiveRingBuffers(ring, &bytes);
+    }
+    bytes = batchBuffers.size();
+    return batchBuffers.data();
+}
+
+int MessageReader::readBatch(int timeoutMillis)
+{
+    // The ring stops receiving when it runs out of buffers, so resume before waiting.
+    if (ring != nullptr && udpArmReceiveRing(ring) < 0)
+    {
+        UDPEVENTS_TRACE(UDPEventsLog::LEVEL_ERROR, "UDP Events Thread can't receive with io_uring on socket {} (errno {}) and will read batches instead.", serverSocket, errno);
+        stopUsingRing();
+    }
+
+    // Wait for a message to arrive, or for someone to wake us.
+    if (waitSetUsable)
+    {
+        UDPWaitResult waitResult = waitSet.wait(timeoutMillis);
+        if (waitResult == UDP_WAIT_ERROR)
+        {
+            // Don't spin on a broken wait set, poll instead.  Another thread might be calling wake(), so leave it open until the next prepare().
+            UDPEVENTS_TRACE(UDPEventsLog::LEVEL_ERROR, "UDP Events Thread can't wait for wakeups on socket {} any more and will poll instead.", serverSocket);
+            waitSetUsable = false;
+            return 0;
+        }
+        // Ring completions are posted by kernel work that interrupts the wait, so check the ring even when the wait was cut short.
+        if (waitResult == UDP_WAIT_WOKEN || (waitResult == UDP_WAIT_TIMEOUT && ring == nullptr))
+        {
+            return 0;
+        }
+    }
+    else if (!udpAwaitMessage(serverSocket, timeoutMillis < 0 ? 100 : timeoutMillis))
+    {
+        // Without wakeups, only wait so long, to let the caller stay responsive to exit requests.
+        return 0;
+    }
+
+    // Drain as many waiting messages as we can with one call, or take as many as landed in the ring.
+    int messageCount = ring != nullptr ? udpReceiveRingBatch(ring, batch, UDP_MAX_BATCH_SIZE) : udpReceiveBatch(serverSocket, batch, UDP_MAX_BATCH_SIZE);
+    if (messageCount < 0)
+    {
+        UDPEVENTS_COUNT(UDPEventsLog::LEVEL_ERROR, "UDP Events Thread had {} read errors in the last second", 1);
+        stats.add(STAT_READ_ERRORS);
+        if (ring != nullptr)
+        {
+            // Something like multishot recvmsg missing from an older kernel, so don't keep trying.
+            UDPEVENTS_TRACE(UDPEventsLog::LEVEL_ERROR, "UDP Events Thread had an io_uring error on socket {} (errno {}) and will read batches instead.", serverSocket, errno);
+            udpReleaseReceiveRing(ring);
+            stopUsingRing();
+        }
+        return messageCount;
+    }
+
+    // Messages should have kernel receive timestamps, and the time since then is how long they waited for us.
+    // If not, use the time we read the batch, close to when we got it.
+    const int64_t readNanos = udpSystemTimeNanos();
+    int64_t bytesRead = 0;
+    unsigned int kernelDropCount = lastKernelDropCount;
+    acks.clear();
+    for (int i = 0; i < messageCount; i++)
+    {
+        bytesRead += std::max(0, batch[i].bytesRead);
+        kernelDropCount = std::max(kernelDropCount, batch[i].dropCount);
+        if (batch[i].receiveNanos == 0)
+        {
+            batch[i].receiveNanos = readNanos;
+        }
+        latency.record(LATENCY_RECEIVE, readNanos - batch[i].receiveNanos);
+        handleMessage(batch[i]);
+    }
+
+    // Events from the batch are enqueued with their text copied out, so the ring can have its buffers back.
+    if (ring != nullptr)
+    {
+        udpReleaseReceiveRing(ring);
+    }
+    stats.add(STAT_MESSAGES_RECEIVED, messageCount);
+    stats.add(STAT_BYTES_RECEIVED, bytesRead);
+
+    // The kernel's drop count only goes up, and comes along with messages that arrive after the drops.
+    if (kernelDropCount > lastKernelDropCount)
+    {
+        const unsigned int newDrops = kernelDropCount - lastKernelDropCount;
+        UDPEVENTS_COUNT(UDPEventsLog::LEVEL_ERROR, "UDP Events Thread saw {} batches with {} messages dropped by the kernel in the last second, consider a larger receive buffer", (int64_t)newDrops);
+        stats.add(STAT_KERNEL_DROPS, newDrops);
+        lastKernelDropCount = kernelDropCount;
+    }
+
+    // Acknowledge the whole batch at once, according to the ack mode.
+    int acksPending = acks.size();
+    if (acksPending > 0)
+    {
+        // Tell clients to back off while process() is falling behind.
+        uint8_t flags = 0;
+        const uint64_t overflowCount = queue.overflowCount();
+        if (queue.size() >= backpressureDepth || overflowCount != lastOverflowCount)
+        {
+            flags = UDP_EVENTS_ACK_FLAG_BACKPRESSURE;
+            stats.add(STAT_BACKPRESSURE_ACKS, acks.extendedCount());
+        }
+        lastOverflowCount = overflowCount;
+        int acksSent = acks.send(serverSocket, flags);
+        if (acksSent < acksPending)
+        {
+            UDPEVENTS_COUNT(UDPEventsLog::LEVEL_ERROR, "UDP Events Thread had {} ack write errors in the last second", 1);
+            stats.add(STAT_ACK_ERRORS, acksPending - std::max(0, acksSent));
+        }
+        stats.add(STAT_ACKS_SENT, std::max(0, acksSent));
+        UDPEVENTS_COUNT(UDPEventsLog::LEVEL_INFO, "UDP Events Thread sent {} batches with {} acks in the last second", std::max(0, acksSent));
+    }
+    return messageCount;
+}
+
+void MessageReader::handleMessage(const struct UdpMessage &message)
+{
+    int bytesRead = message.bytesRead;
+    if (bytesRead <= 0)
+    {
+        UDPEVENTS_COUNT(UDPEventsLog::LEVEL_ERROR, "UDP Events Thread ignored {} empty messages in the last second", 1);
+        return;
+    }
+
+    // Who sent us this message?  The trace log formats the binary address later, if needed.
+    const struct UdpAddress &clientAddress = message.address;
+    UDPEVENTS_COUNT(UDPEventsLog::LEVEL_INFO, "UDP Events Thread received {} messages, {} bytes in the last second", bytesRead);
+    UDPEVENTS_TRACE(UDPEventsLog::LEVEL_DEBUG, "UDP Events Thread received {} bytes from host: {} port: {}", bytesRead, UDPEventsLog::IPv4{(uint32_t)clientAddress.host}, clientAddress.port);
+
+    // Don't parse or ack what's left of a message too long for the receive buffer.
+    if (message.truncated)
+    {
+        UDPEVENTS_COUNT(UDPEventsLog::LEVEL_ERROR, "UDP Events Thread ignored {} messages too long for the receive buffer in the last second", 1);
+        stats.add(STAT_UNKNOWN_MESSAGES);
+        return;
+    }
+
+    // Stats requests get their own reply instead of an ack, and have no events to parse.
+    const char *messageBuffer = message.buffer;
+    uint8_t typeByte = (uint8_t)messageBuffer[0];
+    if ((typeByte & UDP_EVENTS_MESSAGE_TYPE_MASK) == UDP_EVENTS_MESSAGE_TYPE_STATS)
+    {
+        replyWithStats(message);
+        return;
+    }
+
+    // Acknowledge message receipt to the client, or not, according to the ack mode.
+    // The acks go out together after the whole batch is parsed.
+    double clientSeconds = 0.0;
+    if (bytesRead >= 9)
+    {
+        std::memcpy(&clientSeconds, messageBuffer + 1, sizeof(clientSeconds));
+    }
+    acks.add(ackMode, clientAddress, typeByte, message.receiveNanos, clientSeconds);
+
+    // Parse the message itself into events for process().
+    const int64_t parseStart = UDPEventsLatency::nowNanos();
+    parser.parseMessage(messageBuffer, bytesRead, message.receiveNanos);
+    latency.record(LATENCY_PARSE, UDPEventsLatency::nowNanos() - parseStart);
+}
+
+void MessageReader::replyWithStats(const struct UdpMessage &message)
+{
+    double clientSeconds = 0.0;
+    if (message.bytesRead >= 9)
+    {
+        std::memcpy(&clientSeconds, message.buffer + 1, sizeof(clientSeconds));
+    }
+    stats.add(STAT_STATS_REQUESTS);
+    int replyLength = stats.packReply(statsReply, clientSeconds, message.receiveNanos / 1000000);
+    if (udpSendTo(serverSocket, &message.address, statsReply, replyLength) != replyLength)
+    {
+        UDPEVENTS_COUNT(UDPEventsLog::LEVEL_ERROR, "UDP Events Thread failed to send {} stats replies in the last second", 1);
+    }
+}
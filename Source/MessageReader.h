@@ -0,0 +1,138 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef MESSAGEREADER_H_DEFINED
+#define MESSAGEREADER_H_DEFINED
+
+#include <cstdint>
+#include <vector>
+
+#include "AckBatch.h"
+#include "SoftEvent.h"
+#include "SpscRing.h"
+#include "TextArena.h"
+#include "UDPEventsLatency.h"
+#include "UDPEventsParser.h"
+#include "UDPEventsProtocol.h"
+#include "UDPEventsStats.h"
+#include "UDPUtils.h"
+#include "UDPWaitSet.h"
+
+/**
+ * The receive path for one socket: wait for messages, read them in batches, parse them into events, and send acks.
+ *
+ * This doesn't own a thread or the socket, so the same path can run in a plugin receiver thread or a headless benchmark.
+ * Message buffers and acks are allocated once, up front, so reading doesn't allocate.
+ * Where io_uring is supported, messages land in the ring's pooled buffers and are parsed in place, instead of in our own batch buffers.
+ */
+class MessageReader
+{
+public:
+    /** Read into the given queue and arena, and count in the given stats and latency histograms.  The index is recorded in each event, to say which arena holds its text. */
+    MessageReader(uint8_t index, UDPEventsAckMode ackMode, SpscRing<SoftEvent> &queue, TextArena &text, UDPEventsStats &stats, UDPEventsLatency &latency);
+
+    /** Release the io_uring receive ring, if any. */
+    ~MessageReader();
+
+    MessageReader(const MessageReader &) = delete;
+    MessageReader &operator=(const MessageReader &) = delete;
+
+    /** Start reading from a bound socket, with kernel drop counts where supported, before starting the reading thread.
+        With allowRing, receive with io_uring where supported, and otherwise with poll and batch reads.
+        Return false if kernel receive timestamps are not available, so we'll take our own. */
+    bool prepare(int s, bool allowRing = true);
+
+    /** Whether prepare() chose io_uring.  This can change to false if the ring fails while reading. */
+    bool usesRing() const { return ring != nullptr; }
+
+    /** Wait up to the timeout for messages, or until woken, or with a negative timeout for as long as it takes.
+        Then read, parse, and ack one batch of those waiting.
+        Return how many messages were read, 0 if none arrived in time or we were woken, or negative on error.
+        If the system can't wake us, a negative timeout waits at most 100 ms, so callers can still check whether to stop. */
+    int readBatch(int timeoutMillis);
+
+    /** Wake the reading thread from readBatch(), for example to stop.  Any thread can call this after prepare().
+        Once woken, readBatch() returns right away until the next prepare(). */
+    void wake() { waitSet.wake(); }
+
+    /** Whether wake() works here, or readBatch() is polling with short timeouts instead. */
+    bool canWake() const { return waitSetUsable; }
+
+    /** Set the backpressure flag in extended acks while at least this many events are waiting in the queue, or after it overflows. */
+    void setBackpressureDepth(size_t depth) { backpressureDepth = depth; }
+
+    /** Choose what to drop when the queue is at its limit, for a queue set up with configureSoftEventQueue(). */
+    void setOverflowPolicy(UDPEventsOverflowPolicy policy) { parser.setOverflowPolicy(policy); }
+
+    /** The buffers messages land in, from the ring or our own batch buffers, for locking in memory. */
+    const char *getReceiveBuffers(size_t &bytes) const;
+
+private:
+    /** Parse and enqueue one message from a received batch, and add its ack to the batch of acks. */
+    void handleMessage(const struct UdpMessage &message);
+
+    /** Reply right away to a stats request with a snapshot of the stats. */
+    void replyWithStats(const struct UdpMessage &message);
+
+    /** Allocate our own batch buffers, for reading without the ring. */
+    void useBatchBuffers();
+
+    /** Give up on the ring after an error, and go back to waiting on the socket and reading batches. */
+    void stopUsingRing();
+
+    const UDPEventsAckMode ackMode;
+    int serverSocket = -1;
+
+    /** Sleeps until the socket is readable or wake() is called, so there are no idle wakeups.
+        Only prepare() and the destructor close it, since wake() can come from any thread while reading. */
+    UDPWaitSet waitSet;
+
+    /** Whether readBatch() can sleep on the wait set, or has to poll because the wait set failed. */
+    bool waitSetUsable = false;
+
+    /** Optional io_uring receive path, or nullptr to read batches from the socket. */
+    struct UdpReceiveRing *ring = nullptr;
+
+    /** One buffer per message in a batch, so we can read a whole batch of messages per wakeup, unless the ring has its own. */
+    std::vector<char> batchBuffers;
+    struct UdpMessage batch[UDP_MAX_BATCH_SIZE];
+
+    /** Acks for each batch, so they can go out together. */
+    AckBatch acks;
+
+    UDPEventsParser parser;
+
+    /** For checking how full the queue is when sending acks. */
+    SpscRing<SoftEvent> &queue;
+    size_t backpressureDepth;
+    uint64_t lastOverflowCount = 0;
+
+    /** The kernel's running count of messages dropped on this socket, as of the last batch. */
+    unsigned int lastKernelDropCount = 0;
+
+    UDPEventsStats &stats;
+    UDPEventsLatency &latency;
+    char statsReply[UDP_EVENTS_STATS_REPLY_LENGTH];
+};
+
+#endif
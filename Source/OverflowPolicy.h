@@ -0,0 +1,91 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef OVERFLOWPOLICY_H_DEFINED
+#define OVERFLOWPOLICY_H_DEFINED
+
+#include <cstddef>
+#include <cstdint>
+
+#include "SoftEvent.h"
+#include "SpscRing.h"
+#include "UDPEventsStats.h"
+
+/** What to drop when more events arrive than a receiver's queue limit, before process() can take them. */
+enum UDPEventsOverflowPolicy
+{
+    /** Drop arriving events while the queue is at its limit, the original behavior. */
+    OVERFLOW_DROP_NEWEST = 0,
+
+    /** Keep arriving events, and drop the oldest waiting events down to the limit. */
+    OVERFLOW_DROP_OLDEST = 1,
+
+    /** Keep arriving events, and drop waiting text events, oldest first, then the oldest TTL events if that wasn't enough. */
+    OVERFLOW_DROP_TEXT_FIRST = 2
+};
+
+/**
+ * How many slots a receiver's queue should have, to hold to the given limit with the given policy.
+ *
+ * Dropping the newest events needs just the limit.  The other policies have the receiver thread evict waiting events as new ones arrive,
+ * and a text event evicted from the middle of the queue keeps its slot until it reaches the front, so those get room for twice the limit.
+ */
+inline size_t softEventQueueSlots(size_t limit, UDPEventsOverflowPolicy policy)
+{
+    return policy == OVERFLOW_DROP_NEWEST ? limit : 2 * limit;
+}
+
+/** Hold a queue with softEventQueueSlots() capacity to the limit, and let the receiver thread evict waiting events if the policy calls for it.
+    Only call when neither thread is using the queue. */
+inline void configureSoftEventQueue(SpscRing<SoftEvent> &queue, size_t limit, UDPEventsOverflowPolicy policy)
+{
+    queue.setLimit(limit);
+    queue.setEvictable(policy != OVERFLOW_DROP_NEWEST);
+}
+
+/**
+ * Producer: push an event, or make room for it according to the policy, and count what was dropped in the stats.
+ *
+ * This runs on the receiver thread, so events are dropped as they arrive even while process() is stalled.
+ * Events process() has already taken are never evicted.
+ * Return false if the event itself was dropped.
+ */
+inline bool pushSoftEvent(SpscRing<SoftEvent> &queue, const SoftEvent &event, UDPEventsOverflowPolicy policy, UDPEventsStats &stats)
+{
+    if (policy == OVERFLOW_DROP_NEWEST)
+    {
+        return queue.push(event);
+    }
+
+    // The consumer writes its latency timestamp in place, but never the type.
+    const auto countEvicted = [&stats](const SoftEvent &evicted) {
+        stats.add(evicted.type == SOFT_EVENT_TYPE_TEXT ? STAT_QUEUE_DISCARDED_TEXT : STAT_QUEUE_DISCARDED_TTL);
+    };
+    if (policy == OVERFLOW_DROP_TEXT_FIRST)
+    {
+        return queue.pushEvicting(event, [](const SoftEvent &waiting) { return waiting.type == SOFT_EVENT_TYPE_TEXT; }, countEvicted);
+    }
+    return queue.pushEvicting(event, [](const SoftEvent &) { return false; }, countEvicted);
+}
+
+#endif
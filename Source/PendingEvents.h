@@ -0,0 +1,177 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef PENDINGEVENTS_H_DEFINED
+#define PENDINGEVENTS_H_DEFINED
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "SoftEvent.h"
+
+/**
+ * Hold back soft events that arrived before any sync estimate could convert them, sorted by client time.
+ *
+ * Events wait here until a sync estimate covers them, or until their deadline passes.
+ * Sync estimates cover all client times after some point, so events to release are always the newest ones.
+ * Storage is allocated once by configure(), so holding and releasing events doesn't allocate.
+ */
+class PendingEvents
+{
+public:
+    /** Allocate room for the given number of events and start empty. */
+    void configure(size_t capacity)
+    {
+        entries.assign(capacity, Entry());
+        count = 0;
+        earliestDeadline = INT64_MAX;
+    }
+
+    /** Hold an event until the given deadline, return false if there's no room. */
+    bool add(const SoftEvent &event, int64_t deadlineMillis)
+    {
+        if (count >= entries.size())
+        {
+            return false;
+        }
+
+        // Events usually arrive in client time order, but if not, shift later ones over to keep things sorted.
+        size_t position = count;
+        while (position > 0 && entries[position - 1].event.clientSeconds > event.clientSeconds)
+        {
+            entries[position] = entries[position - 1];
+            position--;
+        }
+        entries[position].event = event;
+        entries[position].deadlineMillis = deadlineMillis;
+        count++;
+
+        if (deadlineMillis < earliestDeadline)
+        {
+            earliestDeadline = deadlineMillis;
+        }
+        return true;
+    }
+
+    /** Remove events at or after the given client time and visit them in client time order.  Return how many. */
+    template <typename Visitor>
+    size_t releaseFrom(double clientSeconds, Visitor visit)
+    {
+        // Binary search for the first event to release.
+        size_t low = 0;
+        size_t high = count;
+        while (low < high)
+        {
+            const size_t middle = low + (high - low) / 2;
+            if (entries[middle].event.clientSeconds < clientSeconds)
+            {
+                low = middle + 1;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+
+        const size_t toRelease = count - low;
+        for (size_t i = low; i < count; i++)
+        {
+            visit(entries[i].event);
+        }
+        count = low;
+        return toRelease;
+    }
+
+    /** Remove events whose deadline has passed and visit them.  Return how many. */
+    template <typename Visitor>
+    size_t expire(int64_t nowMillis, Visitor visit)
+    {
+        if (nowMillis < earliestDeadline)
+        {
+            return 0;
+        }
+
+        size_t kept = 0;
+        size_t toExpire = 0;
+        earliestDeadline = INT64_MAX;
+        for (size_t i = 0; i < count; i++)
+        {
+            if (entries[i].deadlineMillis <= nowMillis)
+            {
+                visit(entries[i].event);
+                toExpire++;
+                continue;
+            }
+            if (entries[i].deadlineMillis < earliestDeadline)
+            {
+                earliestDeadline = entries[i].deadlineMillis;
+            }
+            if (kept != i)
+            {
+                entries[kept] = entries[i];
+            }
+            kept++;
+        }
+        count = kept;
+        return toExpire;
+    }
+
+    /** Oldest offset still in use by a held event in the given receiver's TextArena, or UINT64_MAX if none. */
+    uint64_t oldestTextArenaOffset(uint8_t source) const
+    {
+        uint64_t oldest = UINT64_MAX;
+        for (size_t i = 0; i < count; i++)
+        {
+            const SoftEvent &event = entries[i].event;
+            if (event.source == source && !event.hasInlineText() && event.textArenaOffset < oldest)
+            {
+                oldest = event.textArenaOffset;
+            }
+        }
+        return oldest;
+    }
+
+    bool empty() const
+    {
+        return count == 0;
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+private:
+    struct Entry
+    {
+        SoftEvent event;
+        int64_t deadlineMillis = 0;
+    };
+
+    std::vector<Entry> entries;
+    size_t count = 0;
+    int64_t earliestDeadline = INT64_MAX;
+};
+
+#endif
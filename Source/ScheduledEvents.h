@@ -0,0 +1,107 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SCHEDULEDEVENTS_H_DEFINED
+#define SCHEDULEDEVENTS_H_DEFINED
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "SoftEvent.h"
+
+/**
+ * Carry soft events forward to the data block that contains their sample number.
+ *
+ * Events are kept in a min-heap by sample number, so each block can take the ones that are due in sample order.
+ * Storage is reserved once by configure(), so scheduling and releasing events doesn't allocate.
+ * The caller only adds events within a horizon of the current block, so none wait forever, and drops events when full rather than adding them early.
+ */
+class ScheduledEvents
+{
+public:
+    /** Reserve room for the given number of events and start empty. */
+    void configure(size_t capacity)
+    {
+        heap.clear();
+        heap.reserve(capacity);
+        maxSize = capacity;
+    }
+
+    /** Hold an event until the block containing the given sample number, return false if there's no room. */
+    bool add(const SoftEvent &event, int64_t sampleNumber)
+    {
+        if (heap.size() >= maxSize)
+        {
+            return false;
+        }
+        heap.push_back({event, sampleNumber});
+        std::push_heap(heap.begin(), heap.end(), laterSample);
+        return true;
+    }
+
+    /** Remove events with sample numbers before the given one and visit them in sample order.  Return how many. */
+    template <typename Visitor>
+    size_t releaseBefore(int64_t sampleNumber, Visitor visit)
+    {
+        size_t released = 0;
+        while (!heap.empty() && heap.front().sampleNumber < sampleNumber)
+        {
+            std::pop_heap(heap.begin(), heap.end(), laterSample);
+            const Entry &entry = heap.back();
+            visit(entry.event, entry.sampleNumber);
+            heap.pop_back();
+            released++;
+        }
+        return released;
+    }
+
+    bool empty() const
+    {
+        return heap.empty();
+    }
+
+    size_t size() const
+    {
+        return heap.size();
+    }
+
+private:
+    struct Entry
+    {
+        SoftEvent event;
+        int64_t sampleNumber;
+    };
+
+    /** Heap order that puts the earliest sample number at the front. */
+    static bool laterSample(const Entry &a, const Entry &b)
+    {
+        return a.sampleNumber > b.sampleNumber;
+    }
+
+    std::vector<Entry> heap;
+    size_t maxSize = 0;
+};
+
+#endif
@@ -0,0 +1,157 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/** Implement the parts of SidecarFile that are the same for POSIX and Windows systems. */
+
+#include <chrono>
+#include <cstring>
+
+#include "SidecarFile.h"
+
+/** How far ahead of the chunk being written to keep chunks mapped: that one, plus one spare. */
+static const size_t SIDECAR_CHUNKS_AHEAD = 2;
+
+/** How often the grow thread checks on the writer, in case it missed a wakeup. */
+static const std::chrono::seconds SIDECAR_GROW_CHECK_INTERVAL(1);
+
+/** Keep a failure nonzero even if the system didn't say why. */
+static int failureCodeFor(int error)
+{
+    return error != 0 ? error : -1;
+}
+
+SidecarFile::~SidecarFile()
+{
+    close();
+}
+
+bool SidecarFile::open(const char *path, uint32_t nodeId, int64_t startMillis)
+{
+    close();
+    count = 0;
+    writingChunk.store(0, std::memory_order_relaxed);
+    failureCode.store(0, std::memory_order_relaxed);
+    if (!createFile(path))
+    {
+        failureCode.store(failureCodeFor(lastError()), std::memory_order_release);
+        return false;
+    }
+
+    // Map the first chunks here, so the writer has room from the start.
+    for (size_t index = 0; index < SIDECAR_CHUNKS_AHEAD; index++)
+    {
+        if (!mapChunk(index))
+        {
+            failureCode.store(failureCodeFor(lastError()), std::memory_order_release);
+            closeFile(0);
+            return false;
+        }
+        mappedChunks.store(index + 1, std::memory_order_release);
+    }
+
+    const SidecarHeader header = makeSidecarHeader(nodeId, startMillis);
+    memcpy(chunks[0], &header, sizeof(header));
+
+    stopGrowing = false;
+    growThread = std::thread(&SidecarFile::growLoop, this);
+    return true;
+}
+
+bool SidecarFile::append(const SidecarRecord &record)
+{
+    const uint64_t offset = sizeof(SidecarHeader) + count * sizeof(SidecarRecord);
+    const size_t chunk = (size_t)(offset / SIDECAR_FILE_CHUNK_BYTES);
+    if (chunk >= mappedChunks.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+
+    // Starting a new chunk is the cue to map another one ahead of it.
+    if (chunk != writingChunk.load(std::memory_order_relaxed))
+    {
+        writingChunk.store(chunk, std::memory_order_relaxed);
+        growWanted.notify_one();
+    }
+
+    // Write the record before counting it, so readers never see a partial record.
+    memcpy(chunks[chunk] + offset % SIDECAR_FILE_CHUNK_BYTES, &record, sizeof(record));
+    count++;
+    ((SidecarHeader *)chunks[0])->recordCount = count;
+    return true;
+}
+
+void SidecarFile::close()
+{
+    if (fileHandle == -1)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(growLock);
+        stopGrowing = true;
+    }
+    growWanted.notify_all();
+    if (growThread.joinable())
+    {
+        growThread.join();
+    }
+
+    closeFile(sizeof(SidecarHeader) + count * sizeof(SidecarRecord));
+    mappedChunks.store(0, std::memory_order_relaxed);
+}
+
+void SidecarFile::growLoop()
+{
+    std::unique_lock<std::mutex> lock(growLock);
+    while (true)
+    {
+        // append() wakes us without taking the lock, so also check back now and then in case that raced with going to sleep.
+        growWanted.wait_for(lock, SIDECAR_GROW_CHECK_INTERVAL, [this]() {
+            return stopGrowing || writingChunk.load(std::memory_order_relaxed) + SIDECAR_CHUNKS_AHEAD > mappedChunks.load(std::memory_order_relaxed);
+        });
+        if (stopGrowing)
+        {
+            return;
+        }
+        const size_t next = mappedChunks.load(std::memory_order_relaxed);
+        if (writingChunk.load(std::memory_order_relaxed) + SIDECAR_CHUNKS_AHEAD <= next)
+        {
+            continue;
+        }
+
+        // Don't hold the lock while waiting on the filesystem, so close() can always get it.
+        lock.unlock();
+        const bool mapped = mapChunk(next);
+        const int error = mapped ? 0 : failureCodeFor(lastError());
+        lock.lock();
+
+        if (!mapped)
+        {
+            // Leave the chunks we have.  The writer will fail to append once they're full.
+            failureCode.store(error, std::memory_order_release);
+            return;
+        }
+        mappedChunks.store(next + 1, std::memory_order_release);
+    }
+}
@@ -0,0 +1,131 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SIDECARFILE_H_DEFINED
+#define SIDECARFILE_H_DEFINED
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "SidecarFormat.h"
+
+/** How many bytes the file is preallocated and mapped by at a time.
+    A multiple of the record size, so records never straddle chunks, and of page and Windows allocation granularity. */
+#define SIDECAR_FILE_CHUNK_BYTES (4 * 1024 * 1024)
+
+/** Most chunks one file can grow to, for 16 GB at 4 MB each. */
+#define SIDECAR_FILE_MAX_CHUNKS 4096
+
+/**
+ * Append sidecar records to a file through memory mappings, with POSIX vs Windows details in SidecarFile_POSIX.cpp and SidecarFile_WIN32.cpp.
+ *
+ * The file grows in chunks that are each mapped separately, so growing never moves records already mapped.
+ * A background thread preallocates, maps, and touches the next chunk while the writer is still filling the current one,
+ * so append() is a plain copy into memory with no system call, page fault into the filesystem, or SIGBUS when the disk fills.
+ * The header's record count is updated after each append, so the file stays readable if the writer never gets to close().
+ *
+ * open() and close() can block on the filesystem, so call them from a thread that can afford it, like the message thread.
+ * append() is for one writer thread at a time, which must be done appending before close().
+ */
+class SidecarFile
+{
+public:
+    SidecarFile() = default;
+    ~SidecarFile();
+
+    SidecarFile(const SidecarFile &) = delete;
+    SidecarFile &operator=(const SidecarFile &) = delete;
+
+    /** Create or replace the file at the given path, write a header, map room for records, and start growing in the background.
+        Return false on error, with the file closed and failureMessage() saying why. */
+    bool open(const char *path, uint32_t nodeId, int64_t startMillis);
+
+    /** Copy a record to the end of the file.  Return false if there's no mapped room for it,
+        because growing failed (see hasFailed()) or fell behind. */
+    bool append(const SidecarRecord &record);
+
+    /** Stop growing, unmap, and trim the file to just the header and records written.  Safe to call when not open. */
+    void close();
+
+    bool isOpen() const
+    {
+        return fileHandle != -1;
+    }
+
+    uint64_t recordCount() const
+    {
+        return count;
+    }
+
+    /** Whether open() failed, or the background thread failed to grow the file, like when the disk is full.
+        After a failure to grow, appends fail once the mapped room runs out. */
+    bool hasFailed() const
+    {
+        return failureCode.load(std::memory_order_acquire) != 0;
+    }
+
+    /** Describe why open() or growing failed. */
+    const char *failureMessage() const
+    {
+        return describeError(failureCode.load(std::memory_order_acquire));
+    }
+
+private:
+    /** Platform parts: create the file, or preallocate, map, and touch one chunk, or unmap everything and trim and close the file. */
+    bool createFile(const char *path);
+    bool mapChunk(size_t index);
+    void closeFile(size_t usedLength);
+
+    /** Platform error code for the most recent error on the calling thread, and a description of any code. */
+    static int lastError();
+    static const char *describeError(int code);
+
+    /** Keep mapping chunks ahead of the one being written, until close() or an error. */
+    void growLoop();
+
+    /** Platform file handle. */
+    intptr_t fileHandle = -1;
+
+    /** Mapped chunks, in file order.  Entries below mappedChunks are written by the grow thread before it publishes them. */
+    char *chunks[SIDECAR_FILE_MAX_CHUNKS] = {};
+    std::atomic<size_t> mappedChunks{0};
+
+    /** The chunk append() is writing to, so the grow thread knows when to map another. */
+    std::atomic<size_t> writingChunk{0};
+
+    /** Platform error code from open() or the grow thread, or 0. */
+    std::atomic<int> failureCode{0};
+
+    std::thread growThread;
+    std::mutex growLock;
+    std::condition_variable growWanted;
+    bool stopGrowing = false;
+
+    uint64_t count = 0;
+};
+
+#endif
@@ -0,0 +1,137 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/** Implement SidecarFile for POSIX systems like Linux and macOS. */
+
+#ifndef WIN32
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "SidecarFile.h"
+
+/** Allocate disk blocks for a range of the file, extending it as needed, so writes through a mapping can't run out of space. */
+static int preallocate(int fd, off_t offset, off_t length)
+{
+#ifdef __APPLE__
+    // macOS has no posix_fallocate(), but can allocate contiguous or not, then extend.
+    fstore_t store;
+    memset(&store, 0, sizeof(store));
+    store.fst_flags = F_ALLOCATECONTIG;
+    store.fst_posmode = F_PEOFPOSMODE;
+    store.fst_length = length;
+    if (fcntl(fd, F_PREALLOCATE, &store) < 0)
+    {
+        store.fst_flags = F_ALLOCATEALL;
+        if (fcntl(fd, F_PREALLOCATE, &store) < 0)
+        {
+            return -1;
+        }
+    }
+    return ftruncate(fd, offset + length);
+#else
+    // This returns the error rather than setting errno.
+    int result = posix_fallocate(fd, offset, length);
+    if (result != 0)
+    {
+        errno = result;
+        return -1;
+    }
+    return 0;
+#endif
+}
+
+bool SidecarFile::createFile(const char *path)
+{
+    int fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        return false;
+    }
+    fileHandle = fd;
+    return true;
+}
+
+bool SidecarFile::mapChunk(size_t index)
+{
+    if (index >= SIDECAR_FILE_MAX_CHUNKS)
+    {
+        errno = EFBIG;
+        return false;
+    }
+    const off_t offset = (off_t)index * SIDECAR_FILE_CHUNK_BYTES;
+    if (preallocate((int)fileHandle, offset, SIDECAR_FILE_CHUNK_BYTES) < 0)
+    {
+        return false;
+    }
+    void *address = mmap(nullptr, SIDECAR_FILE_CHUNK_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, (int)fileHandle, offset);
+    if (address == MAP_FAILED)
+    {
+        return false;
+    }
+
+    // Take the first write fault on each page here, rather than in the writer.
+    const long pageSize = sysconf(_SC_PAGESIZE);
+    for (size_t pageOffset = 0; pageOffset < SIDECAR_FILE_CHUNK_BYTES; pageOffset += pageSize > 0 ? (size_t)pageSize : 4096)
+    {
+        ((volatile char *)address)[pageOffset] = 0;
+    }
+    chunks[index] = (char *)address;
+    return true;
+}
+
+void SidecarFile::closeFile(size_t usedLength)
+{
+    // Flush and unmap, then trim off the preallocated space past the last record.
+    for (size_t index = 0; index < SIDECAR_FILE_MAX_CHUNKS && chunks[index] != nullptr; index++)
+    {
+        const size_t chunkStart = index * SIDECAR_FILE_CHUNK_BYTES;
+        if (chunkStart < usedLength)
+        {
+            msync(chunks[index], usedLength - chunkStart < SIDECAR_FILE_CHUNK_BYTES ? usedLength - chunkStart : SIDECAR_FILE_CHUNK_BYTES, MS_ASYNC);
+        }
+        munmap(chunks[index], SIDECAR_FILE_CHUNK_BYTES);
+        chunks[index] = nullptr;
+    }
+    if (ftruncate((int)fileHandle, (off_t)usedLength) < 0)
+    {
+        // The file is still readable, just with extra space at the end.
+    }
+    ::close((int)fileHandle);
+    fileHandle = -1;
+}
+
+int SidecarFile::lastError()
+{
+    return errno;
+}
+
+const char *SidecarFile::describeError(int code)
+{
+    return code > 0 ? strerror(code) : "unknown error";
+}
+
+#endif
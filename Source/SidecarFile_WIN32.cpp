@@ -0,0 +1,135 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/** Implement SidecarFile for Windows. */
+
+#ifdef WIN32
+
+#include <stdio.h>
+#include <string.h>
+#include <windows.h>
+
+#include "SidecarFile.h"
+
+static char lastSidecarErrorMessage[256];
+
+bool SidecarFile::createFile(const char *path)
+{
+    HANDLE file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    fileHandle = (intptr_t)file;
+    return true;
+}
+
+bool SidecarFile::mapChunk(size_t index)
+{
+    if (index >= SIDECAR_FILE_MAX_CHUNKS)
+    {
+        SetLastError(ERROR_FILE_TOO_LARGE);
+        return false;
+    }
+
+    // Windows extends and allocates the file to the size of the mapping, and reports a full disk here rather than on write.
+    LARGE_INTEGER offset;
+    offset.QuadPart = (LONGLONG)index * SIDECAR_FILE_CHUNK_BYTES;
+    LARGE_INTEGER size;
+    size.QuadPart = offset.QuadPart + SIDECAR_FILE_CHUNK_BYTES;
+    HANDLE mapping = CreateFileMappingA((HANDLE)fileHandle, NULL, PAGE_READWRITE, (DWORD)(size.QuadPart >> 32), (DWORD)(size.QuadPart & 0xFFFFFFFF), NULL);
+    if (mapping == NULL)
+    {
+        return false;
+    }
+    void *address = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, (DWORD)(offset.QuadPart >> 32), (DWORD)(offset.QuadPart & 0xFFFFFFFF), SIDECAR_FILE_CHUNK_BYTES);
+
+    // The view keeps the mapping alive, so each chunk can have its own without holding on to the handle.
+    CloseHandle(mapping);
+    if (address == NULL)
+    {
+        return false;
+    }
+
+    // Take the first write fault on each page here, rather than in the writer.
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    for (size_t pageOffset = 0; pageOffset < SIDECAR_FILE_CHUNK_BYTES; pageOffset += systemInfo.dwPageSize)
+    {
+        ((volatile char *)address)[pageOffset] = 0;
+    }
+    chunks[index] = (char *)address;
+    return true;
+}
+
+void SidecarFile::closeFile(size_t usedLength)
+{
+    // Flush and unmap, then trim off the preallocated space past the last record.
+    for (size_t index = 0; index < SIDECAR_FILE_MAX_CHUNKS && chunks[index] != nullptr; index++)
+    {
+        const size_t chunkStart = index * SIDECAR_FILE_CHUNK_BYTES;
+        if (chunkStart < usedLength)
+        {
+            FlushViewOfFile(chunks[index], usedLength - chunkStart < SIDECAR_FILE_CHUNK_BYTES ? usedLength - chunkStart : SIDECAR_FILE_CHUNK_BYTES);
+        }
+        UnmapViewOfFile(chunks[index]);
+        chunks[index] = nullptr;
+    }
+    LARGE_INTEGER end;
+    end.QuadPart = (LONGLONG)usedLength;
+    if (SetFilePointerEx((HANDLE)fileHandle, end, NULL, FILE_BEGIN))
+    {
+        SetEndOfFile((HANDLE)fileHandle);
+    }
+    CloseHandle((HANDLE)fileHandle);
+    fileHandle = -1;
+}
+
+int SidecarFile::lastError()
+{
+    return (int)GetLastError();
+}
+
+const char *SidecarFile::describeError(int code)
+{
+    // Only the message thread asks, after open() or close(), so one shared buffer is enough.
+    lastSidecarErrorMessage[0] = '\0';
+    if (code > 0)
+    {
+        FormatMessageA(
+            FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS,
+            NULL,
+            (DWORD)code,
+            MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT),
+            lastSidecarErrorMessage,
+            sizeof(lastSidecarErrorMessage),
+            NULL);
+    }
+    if (!lastSidecarErrorMessage[0])
+    {
+        snprintf(lastSidecarErrorMessage, sizeof(lastSidecarErrorMessage), "GetLastError: %d", code);
+    }
+    return lastSidecarErrorMessage;
+}
+
+#endif
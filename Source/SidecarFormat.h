@@ -0,0 +1,173 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SIDECARFORMAT_H_DEFINED
+#define SIDECARFORMAT_H_DEFINED
+
+/**
+ * Byte layout of the binary sidecar file that UDP Events writes next to each recording.  See also the README.
+ *
+ * The file is a fixed-size header followed by fixed-size records, all little-endian, with no padding between records.
+ * The header's record count says how many records are complete, so readers can ignore any pre-extended space past them.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/** First 8 bytes of every sidecar file. */
+#define UDP_EVENTS_SIDECAR_MAGIC "UDPEVSC1"
+
+/** Bump this when the header or record layout changes. */
+#define UDP_EVENTS_SIDECAR_VERSION 1
+
+/** What a sidecar record describes. */
+enum SidecarRecordKind : uint8_t
+{
+    /** A sync pair accepted into the clock fit: sampleNumber is the real TTL event's sample number. */
+    SIDECAR_SYNC_PAIR = 1,
+
+    /** A sync pair rejected as an outlier, with the fit as it was before the pair. */
+    SIDECAR_SYNC_OUTLIER = 2,
+
+    /** A soft TTL event added to a stream: sampleNumber is the aligned sample number. */
+    SIDECAR_TTL_EVENT = 3,
+
+    /** A soft text event added to a stream: sampleNumber is the aligned sample number.  The text itself is in the recording. */
+    SIDECAR_TEXT_EVENT = 4
+};
+
+/** The first 64 bytes of the file. */
+struct SidecarHeader
+{
+    /** UDP_EVENTS_SIDECAR_MAGIC, not null-terminated. */
+    char magic[8];
+
+    /** UDP_EVENTS_SIDECAR_VERSION. */
+    uint32_t version;
+
+    /** sizeof(SidecarHeader), where records start. */
+    uint32_t headerLength;
+
+    /** sizeof(SidecarRecord), the stride between records. */
+    uint32_t recordLength;
+
+    /** Open Ephys node id of the UDP Events processor that wrote the file. */
+    uint32_t nodeId;
+
+    /** How many complete records follow the header. */
+    uint64_t recordCount;
+
+    /** System time when the file was started, in milliseconds since the Unix epoch. */
+    int64_t startMillis;
+
+    uint8_t reserved[24];
+};
+
+/** One 64-byte record. */
+struct SidecarRecord
+{
+    /** A SidecarRecordKind. */
+    uint8_t kind;
+
+    /** 0-based TTL line: the sync line for sync records, or the event's line for TTL events. */
+    uint8_t line;
+
+    /** TTL line state (nonzero means "on"). */
+    uint8_t state;
+
+    uint8_t reserved0;
+
+    /** Open Ephys id of the data stream. */
+    uint16_t streamId;
+
+    /** Byte length of text, for text events. */
+    uint16_t textLength;
+
+    /** Soft timestamp sent by the client, in seconds. */
+    double clientSeconds;
+
+    /** Sample number on the data stream, as described for each kind. */
+    int64_t sampleNumber;
+
+    /** When UDP Events received the message, or for sync records saw the real TTL event, in nanoseconds since the Unix epoch. */
+    int64_t receiveNanos;
+
+    /** For sync records, the fitted (fractional) sample number at clientSeconds. */
+    double fitSampleNumber;
+
+    /** For sync records, the fitted local samples per client second. */
+    double fitSamplesPerSecond;
+
+    /** For sync records, the typical difference between new pairs and the fit, in samples. */
+    double fitResidualRms;
+
+    /** For sync records, how many pairs are in the fit. */
+    uint32_t fitPairCount;
+
+    uint32_t reserved1;
+};
+
+static_assert(sizeof(SidecarHeader) == 64, "Sidecar header layout must stay 64 bytes.");
+static_assert(sizeof(SidecarRecord) == 64, "Sidecar record layout must stay 64 bytes.");
+static_assert(std::is_trivially_copyable<SidecarRecord>::value, "Sidecar records must be plain old data.");
+
+/** Fill in a header for a new, empty file. */
+inline SidecarHeader makeSidecarHeader(uint32_t nodeId, int64_t startMillis)
+{
+    SidecarHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, UDP_EVENTS_SIDECAR_MAGIC, sizeof(header.magic));
+    header.version = UDP_EVENTS_SIDECAR_VERSION;
+    header.headerLength = sizeof(SidecarHeader);
+    header.recordLength = sizeof(SidecarRecord);
+    header.nodeId = nodeId;
+    header.startMillis = startMillis;
+    return header;
+}
+
+/** Check the header at the start of a sidecar file's bytes, and find its complete records.  Return false if it's not a sidecar we can read. */
+inline bool readSidecar(const void *bytes, size_t length, SidecarHeader &header, const SidecarRecord *&records)
+{
+    if (length < sizeof(SidecarHeader))
+    {
+        return false;
+    }
+    std::memcpy(&header, bytes, sizeof(header));
+    if (std::memcmp(header.magic, UDP_EVENTS_SIDECAR_MAGIC, sizeof(header.magic)) != 0 || header.version != UDP_EVENTS_SIDECAR_VERSION || header.headerLength != sizeof(SidecarHeader) || header.recordLength != sizeof(SidecarRecord))
+    {
+        return false;
+    }
+
+    // Trust the record count only as far as the bytes actually go, in case the writer stopped early.
+    const uint64_t available = (length - sizeof(SidecarHeader)) / sizeof(SidecarRecord);
+    if (header.recordCount > available)
+    {
+        header.recordCount = available;
+    }
+    records = (const SidecarRecord *)((const char *)bytes + sizeof(SidecarHeader));
+    return true;
+}
+
+#endif
@@ -0,0 +1,118 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SOFTEVENT_H_DEFINED
+#define SOFTEVENT_H_DEFINED
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "TextArena.h"
+
+/** Message text up to this many bytes is stored inline, longer text goes in a TextArena. */
+#define SOFT_EVENT_INLINE_TEXT_LENGTH 64
+
+/** Soft message type for TTL events. */
+#define SOFT_EVENT_TYPE_TTL 0x01
+
+/** Soft message type for Text events. */
+#define SOFT_EVENT_TYPE_TEXT 0x02
+
+/**
+ * Hold events received via UDP, until processing them into the selected data stream.
+ *
+ * This is plain old data, so it can be copied between threads without allocating or freeing anything.
+ */
+struct SoftEvent
+{
+    /** 0x01 = "TTL", 0x02 = "Text". */
+    uint8_t type = 0;
+
+    /** 0-based line number for TTL events. */
+    uint8_t lineNumber = 0;
+
+    /** On/off state for TTL events (nonzero means "on"). */
+    uint8_t lineState = 0;
+
+    /** Length in bytes for message text. */
+    uint16_t textLength = 0;
+
+    /** Data stream the client targeted, or 0 for all routed streams. */
+    uint16_t streamId = 0;
+
+    /** Which receiver got this event, and so which TextArena holds its long text. */
+    uint8_t source = 0;
+
+    /** High-precision timestamp from the client's point of view. */
+    double clientSeconds = 0.0;
+
+    /** Acquisition message recv timestamp. */
+    int64_t systemTimeMilliseconds = 0;
+
+    /** Kernel receive time in nanoseconds since the Unix epoch (or our best estimate, if the kernel didn't say). */
+    int64_t receiveNanos = 0;
+
+    /** Monotonic time in nanoseconds when this event finished its latest stage, for latency tracing. */
+    int64_t stageNanos = 0;
+
+    /** Where long message text lives in a TextArena. */
+    uint64_t textArenaOffset = 0;
+
+    /** Short message text, treated as single-byte encoding UTF-8 or ASCII (not null-terminated). */
+    char inlineText[SOFT_EVENT_INLINE_TEXT_LENGTH];
+
+    /** Whether the message text is stored inline rather than in a TextArena. */
+    bool hasInlineText() const
+    {
+        return textLength <= SOFT_EVENT_INLINE_TEXT_LENGTH;
+    }
+
+    /** Store message text inline or in the given arena, return false if the arena was full. */
+    bool setText(const char *text, uint16_t length, TextArena &arena)
+    {
+        textLength = length;
+        if (hasInlineText())
+        {
+            std::memcpy(inlineText, text, length);
+            return true;
+        }
+        return arena.store(text, length, textArenaOffset);
+    }
+
+    /** Get message text from inline or from the given arena. */
+    const char *getText(const TextArena &arena) const
+    {
+        return hasInlineText() ? inlineText : arena.get(textArenaOffset);
+    }
+
+    /** Logical arena offset just past this event's text, or 0 if the text is inline. */
+    uint64_t textArenaEnd() const
+    {
+        return hasInlineText() ? 0 : textArenaOffset + textLength;
+    }
+};
+
+static_assert(std::is_trivially_copyable<SoftEvent>::value, "SoftEvent must be trivially copyable to pass between threads.");
+
+#endif
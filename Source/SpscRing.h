@@ -0,0 +1,374 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SPSCRING_H_DEFINED
+#define SPSCRING_H_DEFINED
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+/** Size to pad to, so producer and consumer indices don't share a cache line. */
+#define SPSC_CACHE_LINE_SIZE 64
+
+/**
+ * Bounded, lock-free queue for handing items from exactly one producer thread to exactly one consumer thread.
+ *
+ * Slots are allocated once, up front, and reused as the producer and consumer indices chase each other around the ring.
+ * Neither side ever blocks: when the ring is full the producer's push() fails and counts an overflow.
+ * The producer can be held to a limit below the full capacity.
+ *
+ * An evictable ring also lets the producer make room by evicting waiting items, with pushEvicting(), to apply overflow policies
+ * even while the consumer is stalled.  Each slot then has a state: the consumer's front() takes the oldest item,
+ * so the producer can evict any other waiting item, and either side can step the tail past evicted items at the front.
+ */
+template <typename T>
+class SpscRing
+{
+public:
+    explicit SpscRing(size_t capacity = 4096)
+    {
+        reset(capacity);
+    }
+
+    SpscRing(const SpscRing &) = delete;
+    SpscRing &operator=(const SpscRing &) = delete;
+
+    /** Allocate slots for at least the given capacity (rounded up to a power of two) and start empty.  Only call when neither thread is using the ring. */
+    void reset(size_t capacity)
+    {
+        size_t slotCount = 1;
+        while (slotCount < capacity)
+        {
+            slotCount <<= 1;
+        }
+        slots.reset(new T[slotCount]);
+        mask = slotCount - 1;
+        limit = slotCount;
+        if (states)
+        {
+            states.reset(new std::atomic<uint8_t>[slotCount]());
+        }
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+        producerTailCache = 0;
+        consumerHeadCache = 0;
+        evictedCount.store(0, std::memory_order_relaxed);
+        evictionScan = 0;
+        overflows.store(0, std::memory_order_relaxed);
+        highWaterMark.store(0, std::memory_order_relaxed);
+    }
+
+    /** Hold the producer to fewer items than the capacity, like an exact limit that's not a power of two.  Only call when neither thread is using the ring. */
+    void setLimit(size_t maxItems)
+    {
+        limit = maxItems < mask + 1 ? maxItems : mask + 1;
+    }
+
+    /** Let the producer evict waiting items with pushEvicting(), at the cost of the consumer taking each item with an atomic exchange.
+        Only call when neither thread is using the ring. */
+    void setEvictable(bool evictable)
+    {
+        states.reset(evictable ? new std::atomic<uint8_t>[mask + 1]() : nullptr);
+    }
+
+    /** Producer: copy an item into an evictable ring, evicting waiting items if needed to stay within the limit.
+        This evicts the oldest waiting item that preferToEvict() accepts, or else the oldest waiting item, and passes each to evicted().
+        Evicted items in the middle of the ring keep their slots until they reach the front, so this can also evict the oldest item to free a slot.
+        Return false and count an overflow only if the consumer has taken the one item in the way.
+        Both callbacks should only read parts of an item the consumer doesn't write in place. */
+    template <typename Prefer, typename Evicted>
+    bool pushEvicting(const T &item, Prefer preferToEvict, Evicted evicted)
+    {
+        const size_t currentHead = head.load(std::memory_order_relaxed);
+        while (waitingItems(currentHead) >= limit)
+        {
+            if (!evictPreferred(currentHead, preferToEvict, evicted) && !evictOldest(currentHead, evicted))
+            {
+                overflows.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+        }
+        while (currentHead - (producerTailCache = tail.load(std::memory_order_acquire)) > mask)
+        {
+            if (!evictOldest(currentHead, evicted))
+            {
+                overflows.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+        }
+
+        slots[currentHead & mask] = item;
+        publishSlot();
+        return true;
+    }
+
+    /** Producer: copy an item into the ring.  Return false and count an overflow if the ring is full. */
+    bool push(const T &item)
+    {
+        T *slot = claimSlot();
+        if (slot == nullptr)
+        {
+            return false;
+        }
+        *slot = item;
+        publishSlot();
+        return true;
+    }
+
+    /** Producer: move an item into the ring.  Return false and count an overflow if the ring is full. */
+    bool push(T &&item)
+    {
+        T *slot = claimSlot();
+        if (slot == nullptr)
+        {
+            return false;
+        }
+        *slot = std::move(item);
+        publishSlot();
+        return true;
+    }
+
+    /** Consumer: peek at the oldest item in place, or get nullptr if the ring is empty.
+        In an evictable ring this also takes the item, so the producer can no longer evict it, and skips items already evicted. */
+    T *front()
+    {
+        while (true)
+        {
+            // The producer can sweep the tail past our cached head in an evictable ring, so check for that too.
+            const size_t currentTail = tail.load(states ? std::memory_order_acquire : std::memory_order_relaxed);
+            if ((ptrdiff_t)(consumerHeadCache - currentTail) <= 0)
+            {
+                consumerHeadCache = head.load(std::memory_order_acquire);
+                if (currentTail == consumerHeadCache)
+                {
+                    return nullptr;
+                }
+            }
+            if (!states)
+            {
+                return &slots[currentTail & mask];
+            }
+
+            std::atomic<uint8_t> &state = states[currentTail & mask];
+            uint8_t expected = SLOT_WAITING;
+            const bool taken = state.compare_exchange_strong(expected, SLOT_TAKEN, std::memory_order_acq_rel, std::memory_order_acquire);
+            if (taken || expected == SLOT_TAKEN)
+            {
+                // The producer can't step the tail past a taken item, so if the tail hasn't moved, this slot still holds the oldest item.
+                if (tail.load(std::memory_order_acquire) == currentTail)
+                {
+                    return &slots[currentTail & mask];
+                }
+                if (taken)
+                {
+                    state.store(SLOT_WAITING, std::memory_order_release);
+                }
+                continue;
+            }
+            sweepEvicted();
+        }
+    }
+
+    /** Consumer: release the oldest item, after front() returned it, so the producer can reuse its slot.
+        The producer never moves the tail past a taken item, so this needs no exchange even in an evictable ring. */
+    void pop()
+    {
+        tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /** Either thread: approximate number of items waiting in the ring, including evicted items that haven't reached the front. */
+    size_t size() const
+    {
+        const size_t currentTail = tail.load(std::memory_order_acquire);
+        const size_t currentHead = head.load(std::memory_order_acquire);
+        return currentHead - currentTail;
+    }
+
+    /** Either thread: how many items the producer can have waiting at once, which is the capacity unless setLimit() lowered it. */
+    size_t maxItems() const
+    {
+        return limit;
+    }
+
+    /** Either thread: how many items the ring can hold at once. */
+    size_t capacity() const
+    {
+        return mask + 1;
+    }
+
+    /** Either thread: the slots themselves, capacity() items long, for locking in memory. */
+    const T *data() const
+    {
+        return slots.get();
+    }
+
+    /** Either thread: how many pushes failed because the ring was full, since the last reset(). */
+    uint64_t overflowCount() const
+    {
+        return overflows.load(std::memory_order_relaxed);
+    }
+
+    /** Either thread: the most items seen waiting in the ring at once, since the last reset(). */
+    size_t maxOccupancy() const
+    {
+        return highWaterMark.load(std::memory_order_relaxed);
+    }
+
+private:
+    /** Slot states for an evictable ring.  Slots start out waiting. */
+    enum : uint8_t
+    {
+        SLOT_WAITING = 0,
+        SLOT_TAKEN = 1,
+        SLOT_EVICTED = 2
+    };
+
+    /** Producer: how many items are waiting and not evicted, as of now.  This can be low by an item or so while the other side sweeps. */
+    size_t waitingItems(size_t currentHead) const
+    {
+        const size_t occupied = currentHead - tail.load(std::memory_order_acquire);
+        const size_t evictedItems = evictedCount.load(std::memory_order_relaxed);
+        return occupied > evictedItems ? occupied - evictedItems : 0;
+    }
+
+    /** Producer: evict the item at the given index if it's still waiting, and pass it to evicted(). */
+    template <typename Evicted>
+    bool evict(size_t index, Evicted &evicted)
+    {
+        // Count it first, so a sweep on the other side can't count it down before we count it up.
+        evictedCount.fetch_add(1, std::memory_order_relaxed);
+        uint8_t expected = SLOT_WAITING;
+        if (!states[index & mask].compare_exchange_strong(expected, SLOT_EVICTED, std::memory_order_acq_rel, std::memory_order_relaxed))
+        {
+            evictedCount.fetch_sub(1, std::memory_order_relaxed);
+            return false;
+        }
+        evicted(slots[index & mask]);
+        return true;
+    }
+
+    /** Producer: evict the oldest waiting item that preferToEvict() accepts.  This picks up where it left off, so each item is checked once. */
+    template <typename Prefer, typename Evicted>
+    bool evictPreferred(size_t currentHead, Prefer &preferToEvict, Evicted &evicted)
+    {
+        const size_t currentTail = tail.load(std::memory_order_acquire);
+        for (size_t index = evictionScan > currentTail ? evictionScan : currentTail; index != currentHead; index++)
+        {
+            if (states[index & mask].load(std::memory_order_acquire) == SLOT_WAITING && preferToEvict(slots[index & mask]) && evict(index, evicted))
+            {
+                evictionScan = index + 1;
+                sweepEvicted();
+                return true;
+            }
+        }
+        evictionScan = currentHead;
+        return false;
+    }
+
+    /** Producer: evict the oldest item the consumer hasn't taken. */
+    template <typename Evicted>
+    bool evictOldest(size_t currentHead, Evicted &evicted)
+    {
+        sweepEvicted();
+        for (size_t index = tail.load(std::memory_order_acquire); index != currentHead; index++)
+        {
+            if (evict(index, evicted))
+            {
+                sweepEvicted();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /** Either thread: step the tail past evicted items at the front, so their slots can be reused. */
+    void sweepEvicted()
+    {
+        size_t currentTail = tail.load(std::memory_order_acquire);
+        while (currentTail != head.load(std::memory_order_acquire) && states[currentTail & mask].load(std::memory_order_acquire) == SLOT_EVICTED)
+        {
+            // On failure this reloads the tail, which the other side might have swept already.
+            if (tail.compare_exchange_weak(currentTail, currentTail + 1, std::memory_order_acq_rel, std::memory_order_acquire))
+            {
+                evictedCount.fetch_sub(1, std::memory_order_relaxed);
+                currentTail++;
+            }
+        }
+    }
+
+    /** Producer: find the next free slot, or count an overflow and return nullptr. */
+    T *claimSlot()
+    {
+        const size_t currentHead = head.load(std::memory_order_relaxed);
+        if (currentHead - producerTailCache >= limit)
+        {
+            producerTailCache = tail.load(std::memory_order_acquire);
+            if (currentHead - producerTailCache >= limit)
+            {
+                overflows.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+        }
+        return &slots[currentHead & mask];
+    }
+
+    /** Producer: make the slot from claimSlot() visible to the consumer. */
+    void publishSlot()
+    {
+        const size_t newHead = head.load(std::memory_order_relaxed) + 1;
+        if (states)
+        {
+            states[(newHead - 1) & mask].store(SLOT_WAITING, std::memory_order_relaxed);
+        }
+        head.store(newHead, std::memory_order_release);
+
+        // The cached tail lags the real one, so this is a conservative (high) estimate.
+        const size_t occupancy = newHead - producerTailCache;
+        if (occupancy > highWaterMark.load(std::memory_order_relaxed))
+        {
+            highWaterMark.store(occupancy, std::memory_order_relaxed);
+        }
+    }
+
+    std::unique_ptr<T[]> slots;
+    std::unique_ptr<std::atomic<uint8_t>[]> states;
+    size_t mask = 0;
+    size_t limit = 0;
+
+    /** Written by the producer, read by the consumer. */
+    alignas(SPSC_CACHE_LINE_SIZE) std::atomic<size_t> head{0};
+    size_t producerTailCache = 0;
+    std::atomic<uint64_t> overflows{0};
+    std::atomic<size_t> highWaterMark{0};
+    std::atomic<size_t> evictedCount{0};
+    size_t evictionScan = 0;
+
+    /** Written by the consumer, read by the producer. */
+    alignas(SPSC_CACHE_LINE_SIZE) std::atomic<size_t> tail{0};
+    size_t consumerHeadCache = 0;
+};
+
+#endif
@@ -0,0 +1,292 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SYNCHISTORY_H_DEFINED
+#define SYNCHISTORY_H_DEFINED
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "ClockModel.h"
+#include "UDPEventsLog.h"
+
+/** Keep track of real and soft sync events and convert client soft secs to local sample numbers. */
+struct SyncEstimate
+{
+    /** Sample number of a real, local, sampled, sync event. */
+    int64_t syncLocalSampleNumber = 0;
+
+    /** Timestamp of a real, local, sampled, sync event, I believe in ms. */
+    double syncLocalTimestamp = 0;
+
+    /** Timestamp of a corresponding soft, external sync event. */
+    double syncSoftSecs = 0.0;
+
+    /** Estimate of the local sample number that corresponds to soft timestamp 0.0.*/
+    int64_t softSampleZero = 0;
+
+    /** Clock model's fitted (fractional) local sample number at syncSoftSecs, as of this estimate. */
+    double fitSampleAtSync = 0.0;
+
+    /** Clock model's fitted local samples per client second, as of this estimate, or 0 if no fit. */
+    double fitSamplesPerSecond = 0.0;
+
+    /** Reset and begin a new estimate. */
+    void clear()
+    {
+        syncLocalSampleNumber = 0;
+        syncLocalTimestamp = 0;
+        syncSoftSecs = 0.0;
+        softSampleZero = 0;
+        fitSampleAtSync = 0.0;
+        fitSamplesPerSecond = 0.0;
+    }
+
+    /** Take a snapshot of the clock model fit, to use for conversions with this estimate. */
+    void recordClockFit(const ClockModel &clockModel)
+    {
+        fitSampleAtSync = clockModel.predict(syncSoftSecs);
+        fitSamplesPerSecond = clockModel.samplesPerSecond();
+    }
+
+    /** Convert a soft, external timestamp to the nearest local sample number, using the clock fit if there is one. */
+    int64_t softSampleNumber(double softSecs, float localSampleRate) const
+    {
+        int64_t sampleNumber = fitSamplesPerSecond > 0.0
+                                   ? (int64_t)std::llround(fitSampleAtSync + (softSecs - syncSoftSecs) * fitSamplesPerSecond)
+                                   : (int64_t)(softSecs * localSampleRate + softSampleZero);
+        UDPEVENTS_TRACE(UDPEventsLog::LEVEL_DEBUG, "SyncEstimate computed sampleNumber {} for softSecs {} at localSampleRate {}", sampleNumber, softSecs, localSampleRate);
+        return sampleNumber;
+    }
+
+    /** Record the sample number of a real sync event, return whether the sync estimate is now complete. */
+    bool recordLocalSampleNumber(int64_t sampleNumber, float localSampleRate)
+    {
+        syncLocalSampleNumber = sampleNumber;
+        UDPEVENTS_TRACE(UDPEventsLog::LEVEL_DEBUG, "SyncEstimate got syncLocalSampleNumber {} at localSampleRate {}", sampleNumber, localSampleRate);
+        if (syncSoftSecs)
+        {
+            softSampleZero = syncLocalSampleNumber - syncSoftSecs * localSampleRate;
+            UDPEVENTS_TRACE(UDPEventsLog::LEVEL_DEBUG, "SyncEstimate computed softSampleZero {}", softSampleZero);
+            return true;
+        }
+        return false;
+    }
+
+    /** Record the timestamp of a real sync event, return whether the sync estimate is now complete. */
+    bool recordLocalTimestamp(int64_t timeStamp, float localSampleRate)
+    {
+        syncLocalTimestamp = timeStamp;
+        UDPEVENTS_TRACE(UDPEventsLog::LEVEL_DEBUG, "SyncEstimate got syncLocalTimestamp {} at localSampleRate {}", timeStamp, localSampleRate);
+        if (syncSoftSecs)
+        {
+            return true;
+        }
+        return false;
+    }
+
+    /** Record the timestamp of a soft sync event, return whether the sync estimate is now complete. */
+    bool recordSoftTimestamp(double softSecs, float localSampleRate)
+    {
+        syncSoftSecs = softSecs;
+        UDPEVENTS_TRACE(UDPEventsLog::LEVEL_DEBUG, "SyncEstimate got syncSoftSecs {} at localSampleRate {}", syncSoftSecs, localSampleRate);
+        if (syncLocalSampleNumber)
+        {
+            softSampleZero = syncLocalSampleNumber - syncSoftSecs * localSampleRate;
+            UDPEVENTS_TRACE(UDPEventsLog::LEVEL_DEBUG, "SyncEstimate computed softSampleZero {}", softSampleZero);
+            return true;
+        }
+        return false;
+    }
+};
+
+/** Choose which real and soft TTL events count as sync events: those on one line, with either or one particular state. */
+struct SyncLineFilter
+{
+    /** 0-based TTL line to sync on. */
+    uint8_t line = 0;
+
+    /** 0 means either state, 1 means only high, 2 means only low. */
+    uint8_t stateIndex = 0;
+
+    /** Whether an event on the given line and state is a sync event. */
+    bool matches(uint8_t eventLine, bool state) const
+    {
+        switch (stateIndex)
+        {
+        case 1:
+            // stateIndex 1 means use only high state.
+            return eventLine == line && state;
+        case 2:
+            // stateIndex 2 means use only low state.
+            return eventLine == line && !state;
+        default:
+            // stateIndex 0 (or other) means use either state.
+            return eventLine == line;
+        }
+    }
+};
+
+/**
+ * Bounded history of completed sync estimates, sorted by client soft seconds, for fast lookup.
+ *
+ * Estimates live in one contiguous, circular buffer allocated up front.
+ * When the history is full the oldest estimate is evicted to make room.
+ * Lookups check the newest estimate first, since most events are recent, and otherwise binary search.
+ */
+class SyncHistory
+{
+public:
+    /** Allocate room for the given number of estimates, and start empty. */
+    void configure(size_t newCapacity)
+    {
+        entries.assign(newCapacity < 1 ? 1 : newCapacity, SyncEstimate());
+        clear();
+    }
+
+    /** Forget all estimates. */
+    void clear()
+    {
+        start = 0;
+        count = 0;
+        evictedAny = false;
+    }
+
+    /** Add an estimate, keeping the history sorted and evicting the oldest estimate if full. */
+    void add(const SyncEstimate &estimate)
+    {
+        if (entries.empty())
+        {
+            configure(DEFAULT_CAPACITY);
+        }
+
+        if (count == entries.size())
+        {
+            // Evict the oldest to make room.
+            start = wrap(start + 1);
+            count--;
+            evictedAny = true;
+        }
+
+        // Estimates usually arrive in order, but if not, shift newer ones over to keep things sorted.
+        size_t position = count;
+        while (position > 0 && at(position - 1).syncSoftSecs > estimate.syncSoftSecs)
+        {
+            at(position) = at(position - 1);
+            position--;
+        }
+        at(position) = estimate;
+        count++;
+    }
+
+    /** Find the last estimate at or before the given client soft seconds, or nullptr if there is none. */
+    const SyncEstimate *find(double softSecs) const
+    {
+        if (count == 0)
+        {
+            return nullptr;
+        }
+
+        // Fast path for the usual case, a recent event.
+        const SyncEstimate &newest = at(count - 1);
+        if (newest.syncSoftSecs <= softSecs)
+        {
+            return &newest;
+        }
+
+        if (softSecs < at(0).syncSoftSecs)
+        {
+            // The event is older than everything we kept.
+            // If older estimates were evicted, the oldest we kept is the next best thing.
+            return evictedAny ? &at(0) : nullptr;
+        }
+
+        // Binary search for the last estimate at or before softSecs, knowing at(0) qualifies and the newest doesn't.
+        size_t low = 0;
+        size_t high = count - 1;
+        while (high - low > 1)
+        {
+            const size_t middle = low + (high - low) / 2;
+            if (at(middle).syncSoftSecs <= softSecs)
+            {
+                low = middle;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+        return &at(low);
+    }
+
+    /** Earliest client soft seconds that find() can convert, or infinity if the history is empty. */
+    double earliestConvertibleSecs() const
+    {
+        if (count == 0)
+        {
+            return HUGE_VAL;
+        }
+        return evictedAny ? -HUGE_VAL : at(0).syncSoftSecs;
+    }
+
+    /** How many estimates are in the history. */
+    size_t size() const
+    {
+        return count;
+    }
+
+    /** How many estimates the history can hold. */
+    size_t capacity() const
+    {
+        return entries.size();
+    }
+
+private:
+    static const size_t DEFAULT_CAPACITY = 1024;
+
+    size_t wrap(size_t index) const
+    {
+        return index >= entries.size() ? index - entries.size() : index;
+    }
+
+    SyncEstimate &at(size_t index)
+    {
+        return entries[wrap(start + index)];
+    }
+
+    const SyncEstimate &at(size_t index) const
+    {
+        return entries[wrap(start + index)];
+    }
+
+    std::vector<SyncEstimate> entries;
+    size_t start = 0;
+    size_t count = 0;
+
+    /** Whether any estimates were evicted since the last clear(), so the oldest one kept stands in for older times. */
+    bool evictedAny = false;
+};
+
+#endif
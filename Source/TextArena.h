@@ -0,0 +1,127 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef TEXTARENA_H_DEFINED
+#define TEXTARENA_H_DEFINED
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+/**
+ * Pre-allocated byte storage for message text that's too long to fit inline in a SoftEvent.
+ *
+ * One producer thread stores text and one consumer thread reads it back, in the same order.
+ * Stored text is addressed by a logical offset that only ever increases, and physical storage wraps around.
+ * Each stored text is contiguous, so the producer skips ahead to the start of storage rather than splitting text at the end.
+ * The consumer doesn't free texts one at a time, it releases everything before a given offset in bulk.
+ */
+class TextArena
+{
+public:
+    explicit TextArena(size_t capacity = 1 << 20)
+    {
+        reset(capacity);
+    }
+
+    TextArena(const TextArena &) = delete;
+    TextArena &operator=(const TextArena &) = delete;
+
+    /** Allocate at least the given capacity in bytes (rounded up to a power of two) and start empty.  Only call when neither thread is using the arena. */
+    void reset(size_t capacity)
+    {
+        size_t byteCount = 1;
+        while (byteCount < capacity)
+        {
+            byteCount <<= 1;
+        }
+        bytes.reset(new char[byteCount]);
+        mask = byteCount - 1;
+        head = 0;
+        released.store(0, std::memory_order_relaxed);
+    }
+
+    /** Producer: copy text into the arena and fill in its logical offset.  Return false if there's no room. */
+    bool store(const char *text, size_t length, uint64_t &offset)
+    {
+        uint64_t start = head;
+        const size_t physicalStart = start & mask;
+        if (physicalStart + length > capacity())
+        {
+            // Skip the leftover bytes at the end, so the text stays contiguous.
+            start += capacity() - physicalStart;
+        }
+
+        const uint64_t end = start + length;
+        if (end - released.load(std::memory_order_acquire) > capacity())
+        {
+            return false;
+        }
+
+        std::memcpy(&bytes[start & mask], text, length);
+        head = end;
+        offset = start;
+        return true;
+    }
+
+    /** Consumer: get text previously stored at the given logical offset. */
+    const char *get(uint64_t offset) const
+    {
+        return &bytes[offset & mask];
+    }
+
+    /** Consumer: let the producer reuse all storage before the given logical offset. */
+    void releaseUpTo(uint64_t offset)
+    {
+        if (offset > released.load(std::memory_order_relaxed))
+        {
+            released.store(offset, std::memory_order_release);
+        }
+    }
+
+    /** Either thread: how many bytes the arena can hold at once. */
+    size_t capacity() const
+    {
+        return mask + 1;
+    }
+
+    /** Either thread: the storage itself, capacity() bytes long, for locking in memory. */
+    const char *data() const
+    {
+        return bytes.get();
+    }
+
+private:
+    std::unique_ptr<char[]> bytes;
+    size_t mask = 0;
+
+    /** Logical end of stored text, only touched by the producer. */
+    uint64_t head = 0;
+
+    /** Logical offset before which the consumer is done with everything. */
+    std::atomic<uint64_t> released{0};
+};
+
+#endif
@@ -0,0 +1,95 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef THREADUTILS_H_DEFINED
+#define THREADUTILS_H_DEFINED
+
+#include <stddef.h>
+#include <stdlib.h>
+
+/** Define a few thread scheduling and memory operations to abstract us away from POSIX vs Windows details.  Each applies to the calling thread. */
+
+/** Get a short description for the most recent thread operation error. */
+const char *threadErrorMessage();
+
+/** Ask for real-time FIFO scheduling at the given priority (1-99, clamped to what the system allows).
+    On Windows, which can't do that for one thread without raising the whole process, this asks for time critical priority instead.
+    Return negative on error, like when we lack permission, leaving scheduling as it was. */
+int threadSetRealtimePriority(int priority);
+
+/** Run only on the CPUs in the mask, with bit i for CPU i.  Return negative on error, or if not supported, like on macOS. */
+int threadSetAffinity(unsigned long long cpuMask);
+
+/** Keep the given memory resident, so touching it never waits on a page fault.  Return negative on error, like when over the lock limit. */
+int threadLockMemory(const void *address, size_t bytes);
+
+/** Let memory locked with threadLockMemory() be paged out again.  Return negative on error. */
+int threadUnlockMemory(const void *address, size_t bytes);
+
+/** Describe the scheduling policy, priority, and CPUs the calling thread actually has, like "SCHED_FIFO priority 50 on CPUs 2-3". */
+void threadDescribeScheduling(char *description, int descriptionLength);
+
+/** Parse a list of CPU numbers and ranges, like "2,3" or "4-7", into a mask with bit i for CPU i.
+    A blank list gives 0, for any CPU.  Return false if the list has anything else, or CPUs past 63. */
+inline bool threadParseCpuList(const char *text, unsigned long long *cpuMask)
+{
+    *cpuMask = 0;
+    const char *next = text;
+    while (*next != '\0')
+    {
+        if (*next == ',' || *next == ' ')
+        {
+            next++;
+            continue;
+        }
+
+        char *end;
+        long first = strtol(next, &end, 10);
+        long last = first;
+        if (end == next)
+        {
+            return false;
+        }
+        next = end;
+        if (*next == '-')
+        {
+            last = strtol(next + 1, &end, 10);
+            if (end == next + 1)
+            {
+                return false;
+            }
+            next = end;
+        }
+        if (first < 0 || last > 63 || first > last)
+        {
+            return false;
+        }
+        for (long cpu = first; cpu <= last; cpu++)
+        {
+            *cpuMask |= 1ULL << cpu;
+        }
+    }
+    return true;
+}
+
+#endif
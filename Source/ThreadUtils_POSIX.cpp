@@ -0,0 +1,155 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/** Implement ThreadUtils for POSIX systems like Linux and macOS. */
+
+#ifndef WIN32
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "ThreadUtils.h"
+
+const char *threadErrorMessage()
+{
+    return strerror(errno);
+}
+
+int threadSetRealtimePriority(int priority)
+{
+    const int minPriority = sched_get_priority_min(SCHED_FIFO);
+    const int maxPriority = sched_get_priority_max(SCHED_FIFO);
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = priority < minPriority ? minPriority : (priority > maxPriority ? maxPriority : priority);
+
+    // Without root or CAP_SYS_NICE, Linux only allows this up to RLIMIT_RTPRIO, which is often 0.
+    int result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (result != 0)
+    {
+        // pthreads return the error rather than setting errno, but threadErrorMessage() reads errno.
+        errno = result;
+        return -1;
+    }
+    return 0;
+}
+
+int threadSetAffinity(unsigned long long cpuMask)
+{
+#ifdef __linux__
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (int cpu = 0; cpu < 64; cpu++)
+    {
+        if (cpuMask & (1ULL << cpu))
+        {
+            CPU_SET(cpu, &cpus);
+        }
+    }
+    int result = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    if (result != 0)
+    {
+        errno = result;
+        return -1;
+    }
+    return 0;
+#else
+    // macOS only takes affinity hints between threads, not CPU masks.
+    (void)cpuMask;
+    errno = ENOTSUP;
+    return -1;
+#endif
+}
+
+int threadLockMemory(const void *address, size_t bytes)
+{
+    // Without root or CAP_IPC_LOCK, Linux only allows this up to RLIMIT_MEMLOCK.
+    return mlock(address, bytes);
+}
+
+int threadUnlockMemory(const void *address, size_t bytes)
+{
+    return munlock(address, bytes);
+}
+
+void threadDescribeScheduling(char *description, int descriptionLength)
+{
+    int policy;
+    struct sched_param param;
+    if (pthread_getschedparam(pthread_self(), &policy, &param) != 0)
+    {
+        snprintf(description, descriptionLength, "unknown scheduling");
+        return;
+    }
+
+    const char *policyName = "SCHED_OTHER";
+    if (policy == SCHED_FIFO)
+    {
+        policyName = "SCHED_FIFO";
+    }
+    else if (policy == SCHED_RR)
+    {
+        policyName = "SCHED_RR";
+    }
+    int written = snprintf(description, descriptionLength, "%s priority %d", policyName, param.sched_priority);
+
+#ifdef __linux__
+    // Append CPUs as ranges, like "on CPUs 0-3,6".
+    cpu_set_t cpus;
+    if (pthread_getaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0)
+    {
+        return;
+    }
+    const char *separator = " on CPUs ";
+    for (int cpu = 0; cpu < CPU_SETSIZE && written > 0 && written < descriptionLength; cpu++)
+    {
+        if (!CPU_ISSET(cpu, &cpus))
+        {
+            continue;
+        }
+        int last = cpu;
+        while (last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, &cpus))
+        {
+            last++;
+        }
+        if (last == cpu)
+        {
+            written += snprintf(description + written, descriptionLength - written, "%s%d", separator, cpu);
+        }
+        else
+        {
+            written += snprintf(description + written, descriptionLength - written, "%s%d-%d", separator, cpu, last);
+        }
+        separator = ",";
+        cpu = last;
+    }
+#else
+    (void)written;
+#endif
+}
+
+#endif
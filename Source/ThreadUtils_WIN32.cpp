@@ -0,0 +1,116 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/** Implement ThreadUtils for Windows systems. */
+
+#ifdef WIN32
+
+#include <stdio.h>
+#include <windows.h>
+
+#include "ThreadUtils.h"
+
+static char lastThreadErrorMessage[256];
+const char *threadErrorMessage()
+{
+    DWORD errorCode = GetLastError();
+
+    // Start with the null-terminated empty string.
+    lastThreadErrorMessage[0] = '\0';
+
+    // Ask the system to describe this error code.
+    FormatMessage(
+        FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS,
+        NULL,
+        errorCode,
+        MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT),
+        lastThreadErrorMessage,
+        sizeof(lastThreadErrorMessage),
+        NULL);
+
+    // In case the system didn't fill in the message, fill in a placeholder.
+    if (!lastThreadErrorMessage[0])
+    {
+        sprintf(lastThreadErrorMessage, "GetLastError: %lu", errorCode);
+    }
+
+    return lastThreadErrorMessage;
+}
+
+int threadSetRealtimePriority(int priority)
+{
+    // Real-time scheduling on Windows means REALTIME_PRIORITY_CLASS for the whole process, which would starve the GUI.
+    // Time critical is the highest priority one thread can have within its process's class.
+    (void)priority;
+    return SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL) ? 0 : -1;
+}
+
+int threadSetAffinity(unsigned long long cpuMask)
+{
+    return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)cpuMask) != 0 ? 0 : -1;
+}
+
+int threadLockMemory(const void *address, size_t bytes)
+{
+    // This can fail past the process's minimum working set size, which is small by default.
+    return VirtualLock((LPVOID)address, bytes) ? 0 : -1;
+}
+
+int threadUnlockMemory(const void *address, size_t bytes)
+{
+    return VirtualUnlock((LPVOID)address, bytes) ? 0 : -1;
+}
+
+void threadDescribeScheduling(char *description, int descriptionLength)
+{
+    const int priority = GetThreadPriority(GetCurrentThread());
+    const char *priorityName = "normal";
+    if (priority == THREAD_PRIORITY_TIME_CRITICAL)
+    {
+        priorityName = "time critical";
+    }
+    else if (priority > THREAD_PRIORITY_NORMAL)
+    {
+        priorityName = "above normal";
+    }
+    else if (priority < THREAD_PRIORITY_NORMAL)
+    {
+        priorityName = "below normal";
+    }
+
+    // There's no call to read a thread's affinity mask directly, but setting it returns the previous one, so set it back.
+    DWORD_PTR processMask;
+    DWORD_PTR systemMask;
+    DWORD_PTR threadMask = 0;
+    if (GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+    {
+        threadMask = SetThreadAffinityMask(GetCurrentThread(), processMask);
+        if (threadMask != 0)
+        {
+            SetThreadAffinityMask(GetCurrentThread(), threadMask);
+        }
+    }
+    snprintf(description, descriptionLength, "%s priority %d with CPU mask 0x%llx", priorityName, priority, (unsigned long long)threadMask);
+}
+
+#endif
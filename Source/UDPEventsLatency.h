@@ -0,0 +1,224 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef UDPEVENTSLATENCY_H_DEFINED
+#define UDPEVENTSLATENCY_H_DEFINED
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+/**
+ * Count nanosecond latencies in log-linear buckets, like an HDR histogram, to read back percentiles.
+ *
+ * Each power of two is split into 32 buckets, so a percentile is within about 3% of the true value.
+ * Values from 0 up to about 68 seconds get their own buckets, and longer ones count in the last bucket.
+ * All buckets are allocated up front and updated with relaxed atomic adds, so several threads can record without locks or allocation.
+ */
+class LatencyHistogram
+{
+public:
+    static const int SUB_BUCKET_BITS = 5;
+    static const uint64_t SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+    static const int MAX_VALUE_BITS = 36;
+    static const size_t BUCKET_COUNT = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+    LatencyHistogram()
+    {
+        clear();
+    }
+
+    void clear()
+    {
+        for (size_t i = 0; i < BUCKET_COUNT; i++)
+        {
+            counts[i].store(0, std::memory_order_relaxed);
+        }
+        total.store(0, std::memory_order_relaxed);
+        maximum.store(0, std::memory_order_relaxed);
+    }
+
+    /** Count one latency.  Negative values, like from a clock step, count as 0. */
+    void record(int64_t nanos)
+    {
+        const uint64_t value = nanos > 0 ? (uint64_t)nanos : 0;
+        counts[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(1, std::memory_order_relaxed);
+        uint64_t previous = maximum.load(std::memory_order_relaxed);
+        while (value > previous && !maximum.compare_exchange_weak(previous, value, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    uint64_t count() const
+    {
+        return total.load(std::memory_order_relaxed);
+    }
+
+    uint64_t max() const
+    {
+        return maximum.load(std::memory_order_relaxed);
+    }
+
+    /** The latency at or below which the given fraction of recorded latencies fall, as the top of its bucket, or 0 if there are none. */
+    uint64_t percentile(double fraction) const
+    {
+        const uint64_t recorded = count();
+        if (recorded == 0)
+        {
+            return 0;
+        }
+
+        // Walk buckets from the bottom until we've passed the requested rank.
+        uint64_t rank = (uint64_t)(fraction * (double)recorded + 0.5);
+        rank = rank < 1 ? 1 : (rank > recorded ? recorded : rank);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKET_COUNT; i++)
+        {
+            seen += counts[i].load(std::memory_order_relaxed);
+            if (seen >= rank)
+            {
+                const uint64_t top = bucketTop(i);
+                return top < max() ? top : max();
+            }
+        }
+        return max();
+    }
+
+private:
+    static int highestBit(uint64_t value)
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return (int)index;
+#else
+        return 63 - __builtin_clzll(value);
+#endif
+    }
+
+    static size_t bucketIndex(uint64_t value)
+    {
+        if (value < SUB_BUCKET_COUNT)
+        {
+            return (size_t)value;
+        }
+        const int bit = highestBit(value);
+        if (bit >= MAX_VALUE_BITS)
+        {
+            return BUCKET_COUNT - 1;
+        }
+        const int shift = bit - SUB_BUCKET_BITS;
+        return (size_t)(shift + 1) * SUB_BUCKET_COUNT + (size_t)((value >> shift) - SUB_BUCKET_COUNT);
+    }
+
+    static uint64_t bucketTop(size_t index)
+    {
+        if (index < SUB_BUCKET_COUNT)
+        {
+            return index;
+        }
+        const int shift = (int)(index / SUB_BUCKET_COUNT) - 1;
+        const uint64_t subBucket = index % SUB_BUCKET_COUNT + SUB_BUCKET_COUNT;
+        return ((subBucket + 1) << shift) - 1;
+    }
+
+    std::atomic<uint64_t> counts[BUCKET_COUNT];
+    std::atomic<uint64_t> total;
+    std::atomic<uint64_t> maximum;
+};
+
+/** Stages an event passes through on its way from a client to a data stream, each with its own latency histogram. */
+enum UDPEventsLatencyStage
+{
+    /** From the kernel receive timestamp to reading the message from the socket. */
+    LATENCY_RECEIVE = 0,
+
+    /** Parsing one message and enqueueing its events. */
+    LATENCY_PARSE,
+
+    /** From enqueueing an event to process() taking it from the queue. */
+    LATENCY_QUEUE,
+
+    /** From process() taking an event to resolving its sample number, including any hold back for a sync estimate. */
+    LATENCY_SYNC,
+
+    /** From resolving an event's sample number to adding it, including any carry forward to a later block. */
+    LATENCY_EMIT,
+
+    /** From the kernel receive timestamp to resolving the sample number, all together, once per event. */
+    LATENCY_TOTAL,
+
+    LATENCY_STAGE_COUNT
+};
+
+/**
+ * One latency histogram per stage, shared by receiver threads, process(), and the editor.
+ *
+ * Stages within this process use a monotonic clock, via nowNanos().
+ * The receive and total stages start from kernel receive timestamps, which use the system clock, so they end on the system clock, too.
+ */
+class UDPEventsLatency
+{
+public:
+    /** Monotonic time in nanoseconds, to timestamp stages. */
+    static int64_t nowNanos()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void clear()
+    {
+        for (size_t i = 0; i < LATENCY_STAGE_COUNT; i++)
+        {
+            stages[i].clear();
+        }
+    }
+
+    void record(UDPEventsLatencyStage stage, int64_t nanos)
+    {
+        stages[stage].record(nanos);
+    }
+
+    const LatencyHistogram &get(UDPEventsLatencyStage stage) const
+    {
+        return stages[stage];
+    }
+
+    /** Short name for a stage, for display and reports. */
+    static const char *name(UDPEventsLatencyStage stage)
+    {
+        static const char *const names[LATENCY_STAGE_COUNT] = {"receive", "parse", "queue", "sync", "emit", "total"};
+        return stage < LATENCY_STAGE_COUNT ? names[stage] : "unknown";
+    }
+
+private:
+    LatencyHistogram stages[LATENCY_STAGE_COUNT];
+};
+
+#endif
@@ -0,0 +1,293 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "UDPEventsLog.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace UDPEventsLog
+{
+    /** How many trace records can wait for the background thread. */
+    const size_t RING_CAPACITY = 4096;
+
+    /** How often the background thread prints counter summaries. */
+    const std::chrono::seconds SUMMARY_INTERVAL(1);
+
+    struct Record
+    {
+        const Site *site;
+        Value values[MAX_VALUES];
+        int valueCount;
+    };
+
+    /** Ring cell with a sequence number, so multiple producers can claim cells without a lock. */
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        Record record;
+    };
+
+    static Cell cells[RING_CAPACITY];
+    static std::atomic<size_t> enqueuePosition{0};
+    static size_t dequeuePosition = 0;
+    static std::atomic<int64_t> droppedRecords{0};
+
+    static std::atomic<Counter *> counters{nullptr};
+
+    static std::mutex lifecycleLock;
+    static std::condition_variable formatWanted;
+
+    /** Whether the background thread is going to sleep with nothing to format, so the next record should wake it. */
+    static std::atomic<bool> formatIdle{false};
+    static std::thread formatThread;
+    static int userCount = 0;
+    static bool shouldStop = false;
+    static Sink currentSink = nullptr;
+
+    /** Set up cell sequence numbers before anyone can push. */
+    static bool initializeCells()
+    {
+        for (size_t i = 0; i < RING_CAPACITY; i++)
+        {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        return true;
+    }
+    static const bool cellsInitialized = initializeCells();
+
+    Counter::Counter(Level level, const char *format)
+        : level(level), format(format)
+    {
+        next = counters.load(std::memory_order_relaxed);
+        while (!counters.compare_exchange_weak(next, this, std::memory_order_release, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    void push(const Site &site, const Value *values, int valueCount)
+    {
+        size_t position = enqueuePosition.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true)
+        {
+            cell = &cells[position % RING_CAPACITY];
+            const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+            if (difference == 0)
+            {
+                if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (difference < 0)
+            {
+                // The background thread is behind and the ring is full.
+                droppedRecords.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            else
+            {
+                position = enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->record.site = &site;
+        cell->record.valueCount = valueCount;
+        for (int i = 0; i < valueCount; i++)
+        {
+            cell->record.values[i] = values[i];
+        }
+        cell->sequence.store(position + 1, std::memory_order_release);
+
+        // Wake the background thread for the first record since it went idle, so most records don't cost a wakeup.
+        // This doesn't take the lock, so a wakeup can slip past as the thread goes to sleep, but it still wakes for the next summary.
+        if (formatIdle.load(std::memory_order_relaxed) && formatIdle.exchange(false))
+        {
+            formatWanted.notify_one();
+        }
+    }
+
+    /** Append one value to a line being formatted. */
+    static void appendValue(std::string &line, const Value &value)
+    {
+        char text[32];
+        switch (value.kind)
+        {
+        case Value::INT:
+            std::snprintf(text, sizeof(text), "%lld", (long long)value.i);
+            break;
+        case Value::DOUBLE:
+            std::snprintf(text, sizeof(text), "%.9g", value.d);
+            break;
+        case Value::IPV4:
+        {
+            // The host is in network byte order, so the first octet is the first byte in memory.
+            const uint32_t host = (uint32_t)value.i;
+            const unsigned char *octets = (const unsigned char *)&host;
+            std::snprintf(text, sizeof(text), "%u.%u.%u.%u", octets[0], octets[1], octets[2], octets[3]);
+            break;
+        }
+        default:
+            text[0] = '\0';
+            break;
+        }
+        line += text;
+    }
+
+    /** Substitute values, in order, for "{}" placeholders in the format. */
+    static std::string formatLine(const char *format, const Value *values, int valueCount)
+    {
+        std::string line;
+        int valueIndex = 0;
+        for (const char *c = format; *c; c++)
+        {
+            if (c[0] == '{' && c[1] == '}' && valueIndex < valueCount)
+            {
+                appendValue(line, values[valueIndex++]);
+                c++;
+            }
+            else
+            {
+                line += *c;
+            }
+        }
+        return line;
+    }
+
+    /** Whether a record is ready for the background thread.  Only called on the background thread. */
+    static bool recordWaiting()
+    {
+        return cells[dequeuePosition % RING_CAPACITY].sequence.load(std::memory_order_acquire) == dequeuePosition + 1;
+    }
+
+    /** Format and emit everything waiting in the ring.  Only called on the background thread. */
+    static void drainRecords(Sink sink)
+    {
+        while (true)
+        {
+            Cell *cell = &cells[dequeuePosition % RING_CAPACITY];
+            const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            if (sequence != dequeuePosition + 1)
+            {
+                break;
+            }
+
+            Record record = cell->record;
+            cell->sequence.store(dequeuePosition + RING_CAPACITY, std::memory_order_release);
+            dequeuePosition++;
+
+            if (sink)
+            {
+                sink(record.site->level, formatLine(record.site->format, record.values, record.valueCount).c_str());
+            }
+        }
+    }
+
+    /** Emit a summary for each counter that counted anything since last time.  Only called on the background thread. */
+    static void summarizeCounters(Sink sink)
+    {
+        for (Counter *counter = counters.load(std::memory_order_acquire); counter; counter = counter->next)
+        {
+            const Value values[2] = {Value(counter->count.exchange(0, std::memory_order_relaxed)),
+                                     Value(counter->total.exchange(0, std::memory_order_relaxed))};
+            if (values[0].i > 0 && sink)
+            {
+                sink(counter->level, formatLine(counter->format, values, 2).c_str());
+            }
+        }
+
+        const int64_t dropped = droppedRecords.exchange(0, std::memory_order_relaxed);
+        if (dropped > 0 && sink)
+        {
+            const Value value(dropped);
+            sink(LEVEL_ERROR, formatLine("UDP Events log dropped {} trace records in the last second", &value, 1).c_str());
+        }
+    }
+
+    static void formatLoop()
+    {
+        auto nextSummary = std::chrono::steady_clock::now() + SUMMARY_INTERVAL;
+        std::unique_lock<std::mutex> lock(lifecycleLock);
+        while (true)
+        {
+            // Sleep until a record arrives, it's time for a summary, or stop() -- with no wakeups in between when idle.
+            formatIdle.store(true);
+            formatWanted.wait_until(lock, nextSummary, []() { return shouldStop || !formatIdle.load() || recordWaiting(); });
+            formatIdle.store(false);
+            const bool stopping = shouldStop;
+            const Sink sink = currentSink;
+
+            // Don't hold the lock while formatting and printing.
+            lock.unlock();
+            drainRecords(sink);
+            if (stopping || std::chrono::steady_clock::now() >= nextSummary)
+            {
+                summarizeCounters(sink);
+                nextSummary = std::chrono::steady_clock::now() + SUMMARY_INTERVAL;
+            }
+            lock.lock();
+
+            if (stopping)
+            {
+                return;
+            }
+        }
+    }
+
+    void start(Sink sink)
+    {
+        std::lock_guard<std::mutex> lock(lifecycleLock);
+        currentSink = sink;
+        if (userCount++ == 0)
+        {
+            shouldStop = false;
+            formatThread = std::thread(formatLoop);
+        }
+    }
+
+    void stop()
+    {
+        std::thread toJoin;
+        {
+            std::lock_guard<std::mutex> lock(lifecycleLock);
+            if (userCount == 0 || --userCount > 0)
+            {
+                return;
+            }
+            shouldStop = true;
+            toJoin = std::move(formatThread);
+        }
+        formatWanted.notify_all();
+        if (toJoin.joinable())
+        {
+            toJoin.join();
+        }
+    }
+}
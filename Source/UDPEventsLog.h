@@ -0,0 +1,164 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef UDPEVENTSLOG_H_DEFINED
+#define UDPEVENTSLOG_H_DEFINED
+
+/**
+ * Logging for the per-message hot paths of UDP Events, without formatting strings or writing to the console on those paths.
+ *
+ * UDPEVENTS_TRACE() copies a few numeric arguments into a lock-free ring of binary records.
+ * UDPEVENTS_COUNT() just bumps a per-site counter, and the background thread prints a summary once per second.
+ * A background thread formats records and summaries and hands finished lines to a sink, like Open Ephys LOGC.
+ * It sleeps until a record arrives or the next summary is due, so it doesn't wake up while things are quiet.
+ *
+ * Trace sites above UDPEVENTS_LOG_LEVEL compile away to nothing.
+ */
+
+#include <atomic>
+#include <cstdint>
+
+/** 0 = errors only, 1 = also info, 2 = also debug. */
+#ifndef UDPEVENTS_LOG_LEVEL
+#define UDPEVENTS_LOG_LEVEL 1
+#endif
+
+namespace UDPEventsLog
+{
+    enum Level
+    {
+        LEVEL_ERROR = 0,
+        LEVEL_INFO = 1,
+        LEVEL_DEBUG = 2
+    };
+
+    /** One place in the code that traces, with a format like "got {} bytes from {}". */
+    struct Site
+    {
+        Level level;
+        const char *format;
+    };
+
+    /** One place in the code that counts, summarized once per second with a format like "got {} messages, {} bytes". */
+    class Counter
+    {
+    public:
+        Counter(Level level, const char *format);
+
+        /** Count one occurrence and add to the running total. */
+        void add(int64_t amount)
+        {
+            count.fetch_add(1, std::memory_order_relaxed);
+            total.fetch_add(amount, std::memory_order_relaxed);
+        }
+
+        const Level level;
+        const char *const format;
+        std::atomic<int64_t> count{0};
+        std::atomic<int64_t> total{0};
+
+        /** Counters register themselves in a list the background thread can walk. */
+        Counter *next = nullptr;
+    };
+
+    /** Wrap an IPv4 host in network byte order, like UdpAddress.host, to trace it as a dotted quad. */
+    struct IPv4
+    {
+        uint32_t host;
+    };
+
+    /** One traced argument, stored in binary. */
+    struct Value
+    {
+        enum Kind : uint8_t
+        {
+            NONE,
+            INT,
+            DOUBLE,
+            IPV4
+        };
+        Kind kind = NONE;
+        union
+        {
+            int64_t i;
+            double d;
+        };
+
+        Value() : i(0) {}
+        Value(bool value) : kind(INT), i(value) {}
+        Value(int value) : kind(INT), i(value) {}
+        Value(unsigned int value) : kind(INT), i(value) {}
+        Value(long value) : kind(INT), i(value) {}
+        Value(unsigned long value) : kind(INT), i((int64_t)value) {}
+        Value(long long value) : kind(INT), i(value) {}
+        Value(unsigned long long value) : kind(INT), i((int64_t)value) {}
+        Value(float value) : kind(DOUBLE), d(value) {}
+        Value(double value) : kind(DOUBLE), d(value) {}
+        Value(IPv4 value) : kind(IPV4), i(value.host) {}
+    };
+
+    /** Most arguments a trace site can record. */
+    const int MAX_VALUES = 4;
+
+    /** Copy a trace record into the ring, or count it as dropped if the ring is full.  Safe to call from any thread. */
+    void push(const Site &site, const Value *values, int valueCount);
+
+    template <typename... Args>
+    inline void record(const Site &site, Args... args)
+    {
+        static_assert(sizeof...(Args) <= MAX_VALUES, "Too many values for one trace record.");
+        const Value values[MAX_VALUES + 1] = {Value(args)...};
+        push(site, values, (int)sizeof...(Args));
+    }
+
+    /** Receive each formatted line on the background thread. */
+    typedef void (*Sink)(Level level, const char *line);
+
+    /** Start the background thread if needed and count one more user.  The most recent sink wins. */
+    void start(Sink sink);
+
+    /** Count one less user, and flush and stop the background thread when there are none left. */
+    void stop();
+}
+
+#define UDPEVENTS_TRACE(level, format, ...)                                               \
+    do                                                                                    \
+    {                                                                                     \
+        if constexpr ((level) <= UDPEVENTS_LOG_LEVEL)                                     \
+        {                                                                                 \
+            static const UDPEventsLog::Site traceSite = {(level), (format)};              \
+            UDPEventsLog::record(traceSite, ##__VA_ARGS__);                               \
+        }                                                                                 \
+    } while (0)
+
+#define UDPEVENTS_COUNT(level, format, amount)                                            \
+    do                                                                                    \
+    {                                                                                     \
+        if constexpr ((level) <= UDPEVENTS_LOG_LEVEL)                                     \
+        {                                                                                 \
+            static UDPEventsLog::Counter traceCounter((level), (format));                 \
+            traceCounter.add(amount);                                                     \
+        }                                                                                 \
+    } while (0)
+
+#endif
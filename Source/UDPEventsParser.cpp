@@ -0,0 +1,184 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "UDPEventsParser.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "UDPEventsLatency.h"
+#include "UDPEventsLog.h"
+#include "UDPEventsProtocol.h"
+#include "UDPUtils.h"
+
+UDPEventsParser::UDPEventsParser(uint8_t source, SpscRing<SoftEvent> &queue, TextArena &text, UDPEventsStats &stats)
+    : source(source), softEventQueue(queue), softEventText(text), stats(stats)
+{
+}
+
+int UDPEventsParser::parseMessage(const char *message, int length, int64_t receiveNanos)
+{
+    // Process the message itself, ignoring any flag bits in the message type.
+    uint8_t messageType = (uint8_t)message[0] & UDP_EVENTS_MESSAGE_TYPE_MASK;
+    if (messageType == UDP_EVENTS_MESSAGE_TYPE_BATCH)
+    {
+        return parseBatch(message, length, receiveNanos);
+    }
+    if (parseRecord(message, length, receiveNanos) == 0)
+    {
+        // This seems to be some unexpected message, and we'll ignore it.
+        UDPEVENTS_TRACE(UDPEventsLog::LEVEL_ERROR, "UDP Events Thread ignoring message of unknown type {} and byte size {}", messageType, length);
+        stats.add(STAT_UNKNOWN_MESSAGES);
+        return 0;
+    }
+    return 1;
+}
+
+int UDPEventsParser::parseBatch(const char *message, int length, int64_t receiveNanos)
+{
+    if (length < UDP_EVENTS_HEADER_LENGTH)
+    {
+        UDPEVENTS_COUNT(UDPEventsLog::LEVEL_ERROR, "UDP Events Thread ignored {} batch messages too short for a header in the last second", 1);
+        stats.add(STAT_UNKNOWN_MESSAGES);
+        return 0;
+    }
+
+    // Unpack each record in turn, in one pass, straight into the event queue.
+    uint16_t networkShort;
+    std::memcpy(&networkShort, message + 9, sizeof(networkShort));
+    uint16_t recordCount = udpNToHS(networkShort);
+    int offset = UDP_EVENTS_HEADER_LENGTH;
+    int recordsRead = 0;
+    while (recordsRead < recordCount && offset < length)
+    {
+        int recordLength = parseRecord(message + offset, length - offset, receiveNanos);
+        if (recordLength == 0)
+        {
+            // We can't tell where the next record starts, so give up on the rest of the batch.
+            UDPEVENTS_TRACE(UDPEventsLog::LEVEL_ERROR, "UDP Events Thread ignoring batch record {} of {} with unknown type {} or too few bytes", recordsRead, recordCount, (uint8_t)message[offset]);
+            stats.add(STAT_UNKNOWN_MESSAGES);
+            break;
+        }
+        offset += recordLength;
+        recordsRead++;
+    }
+    if (recordsRead < recordCount)
+    {
+        UDPEVENTS_COUNT(UDPEventsLog::LEVEL_ERROR, "UDP Events Thread got {} batch messages with {} fewer records than declared in the last second", recordCount - recordsRead);
+    }
+    UDPEVENTS_COUNT(UDPEventsLog::LEVEL_INFO, "UDP Events Thread received {} batch messages with {} records in the last second", recordsRead);
+    return recordsRead;
+}
+
+int UDPEventsParser::parseRecord(const char *record, int length, int64_t receiveNanos)
+{
+    if (length < UDP_EVENTS_HEADER_LENGTH)
+    {
+        return 0;
+    }
+
+    // Records that target one stream carry its id in 2 bytes just past the usual record.
+    uint8_t typeByte = (uint8_t)record[0];
+    uint8_t recordType = typeByte & UDP_EVENTS_MESSAGE_TYPE_MASK;
+    int streamIdBytes = (typeByte & UDP_EVENTS_FLAG_STREAM_TARGETED) ? 2 : 0;
+    if (length < UDP_EVENTS_HEADER_LENGTH + streamIdBytes)
+    {
+        // Without its stream id this record would go to every stream, so treat it as malformed.
+        return 0;
+    }
+
+    // Records in a batch can start at any byte, so copy multi-byte fields rather than casting pointers.
+    SoftEvent softEvent;
+    softEvent.source = source;
+    std::memcpy(&softEvent.clientSeconds, record + 1, sizeof(softEvent.clientSeconds));
+    softEvent.receiveNanos = receiveNanos;
+    softEvent.systemTimeMilliseconds = receiveNanos / 1000000;
+    uint16_t networkShort;
+
+    if (recordType == SOFT_EVENT_TYPE_TTL)
+    {
+        // This is a TTL record.
+        softEvent.type = SOFT_EVENT_TYPE_TTL;
+        softEvent.lineNumber = (uint8_t)record[9];
+        softEvent.lineState = (uint8_t)record[10];
+        if (streamIdBytes)
+        {
+            std::memcpy(&networkShort, record + UDP_EVENTS_HEADER_LENGTH, sizeof(networkShort));
+            softEvent.streamId = udpNToHS(networkShort);
+        }
+
+        UDPEVENTS_TRACE(UDPEventsLog::LEVEL_DEBUG, "UDP Events Thread got a TTL message with client timestamp: {} 0-based line number: {} line state: {}", softEvent.clientSeconds, softEvent.lineNumber, softEvent.lineState);
+
+        // Enqueue this to be handled on the main thread, in process().
+        enqueueSoftEvent(softEvent);
+        return UDP_EVENTS_HEADER_LENGTH + streamIdBytes;
+    }
+    else if (recordType == SOFT_EVENT_TYPE_TEXT)
+    {
+        // This is a Text record.
+        softEvent.type = SOFT_EVENT_TYPE_TEXT;
+
+        std::memcpy(&networkShort, record + 9, sizeof(networkShort));
+        uint16_t textLength = udpNToHS(networkShort);
+        if (streamIdBytes)
+        {
+            // The stream id follows the text, so a record cut short anywhere has lost it, and would go to every stream.
+            if (length < UDP_EVENTS_HEADER_LENGTH + textLength + streamIdBytes)
+            {
+                return 0;
+            }
+
+            std::memcpy(&networkShort, record + UDP_EVENTS_HEADER_LENGTH + textLength, sizeof(networkShort));
+            softEvent.streamId = udpNToHS(networkShort);
+        }
+
+        // Otherwise, don't trust the declared length past the end of what we actually received.
+        textLength = (uint16_t)std::min((int)textLength, length - UDP_EVENTS_HEADER_LENGTH);
+        const int recordLength = std::min(length, UDP_EVENTS_HEADER_LENGTH + textLength + streamIdBytes);
+
+        // Copy the text inline or into pre-allocated arena storage, so there's no allocation here and no free in process().
+        if (!softEvent.setText(record + UDP_EVENTS_HEADER_LENGTH, textLength, softEventText))
+        {
+            UDPEVENTS_COUNT(UDPEventsLog::LEVEL_ERROR, "UDP Events Thread dropped {} Text messages in the last second because text storage is full", 1);
+            stats.add(STAT_TEXT_STORAGE_FULL);
+            return recordLength;
+        }
+
+        UDPEVENTS_TRACE(UDPEventsLog::LEVEL_DEBUG, "UDP Events Thread got a Text message with client timestamp: {} message length: {}", softEvent.clientSeconds, softEvent.textLength);
+
+        // Enqueue this to be handled on the main thread, in process().
+        enqueueSoftEvent(softEvent);
+        return recordLength;
+    }
+    return 0;
+}
+
+void UDPEventsParser::enqueueSoftEvent(SoftEvent &softEvent)
+{
+    softEvent.stageNanos = UDPEventsLatency::nowNanos();
+    if (!pushSoftEvent(softEventQueue, softEvent, overflowPolicy, stats))
+    {
+        UDPEVENTS_COUNT(UDPEventsLog::LEVEL_ERROR, "UDP Events Thread dropped {} messages in the last second because the event queue is full", 1);
+        stats.add(STAT_QUEUE_OVERFLOWS);
+    }
+}
@@ -0,0 +1,71 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef UDPEVENTSPARSER_H_DEFINED
+#define UDPEVENTSPARSER_H_DEFINED
+
+#include <cstdint>
+
+#include "OverflowPolicy.h"
+#include "SoftEvent.h"
+#include "SpscRing.h"
+#include "TextArena.h"
+#include "UDPEventsStats.h"
+
+/**
+ * Parse received UDP Events messages into soft events, and hand them to process() through a lock-free queue.
+ *
+ * This handles TTL, text, and batch messages, with or without stream targets, as described in UDPEventsProtocol.h.
+ * It doesn't know about sockets or acks, so it can be driven from a receiver thread, a benchmark, or a test.
+ * Text too long to fit inline goes to a pre-allocated arena, so parsing never allocates.
+ */
+class UDPEventsParser
+{
+public:
+    /** Parse into the given queue and arena, and count drops in the given stats.  The source is recorded in each event, to say which arena holds its text. */
+    UDPEventsParser(uint8_t source, SpscRing<SoftEvent> &queue, TextArena &text, UDPEventsStats &stats);
+
+    /** Choose what to drop when the queue is at its limit, for a queue set up with configureSoftEventQueue(). */
+    void setOverflowPolicy(UDPEventsOverflowPolicy policy) { overflowPolicy = policy; }
+
+    /** Parse one message and enqueue its events.  Return how many TTL or text records it had. */
+    int parseMessage(const char *message, int length, int64_t receiveNanos);
+
+private:
+    /** Parse and enqueue each TTL or text record in a batch message.  Return how many there were. */
+    int parseBatch(const char *message, int length, int64_t receiveNanos);
+
+    /** Parse and enqueue one TTL or text record, on its own or within a batch.  Return its length in bytes, or 0 if it's not a known record. */
+    int parseRecord(const char *record, int length, int64_t receiveNanos);
+
+    /** Stamp a parsed event and hand it to process(), making room by the overflow policy, or count and report a drop if the queue is full. */
+    void enqueueSoftEvent(SoftEvent &softEvent);
+
+    const uint8_t source;
+    SpscRing<SoftEvent> &softEventQueue;
+    TextArena &softEventText;
+    UDPEventsStats &stats;
+    UDPEventsOverflowPolicy overflowPolicy = OVERFLOW_DROP_NEWEST;
+};
+
+#endif
@@ -22,10 +22,30 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "UDPEventsPlugin.h"
 #include "UDPEventsPluginEditor.h"
+#include "UDPEventsReceiver.h"
 #include "UDPUtils.h"
 
+#include <thread>
+
+/** Print formatted lines from the UDP Events log with the usual Open Ephys logging. */
+static void logToOpenEphys(UDPEventsLog::Level level, const char *line)
+{
+    switch (level)
+    {
+    case UDPEventsLog::LEVEL_ERROR:
+        LOGE(line);
+        break;
+    case UDPEventsLog::LEVEL_DEBUG:
+        LOGD(line);
+        break;
+    default:
+        LOGC(line);
+        break;
+    }
+}
+
 UDPEventsPlugin::UDPEventsPlugin()
-    : GenericProcessor("UDP Events"), Thread("UDP Events Thread")
+    : GenericProcessor("UDP Events")
 { 
 }
 
@@ -53,6 +73,13 @@ void UDPEventsPlugin::registerParameters()
         "127.0.0.1",
         true);
 
+    // Optional multicast group to join, so one message from a client can reach several instances.
+    addStringParameter(Parameter::PROCESSOR_SCOPE, "group",
+        "Group",
+        "Multicast group address to join via the Host interface, or blank to receive only messages sent to Host",
+        "",
+        true);
+
     // Id of data stream to filter.
     addIntParameter(Parameter::PROCESSOR_SCOPE, "stream",
         "Stream",
@@ -62,6 +89,144 @@ void UDPEventsPlugin::registerParameters()
         65535,
         true);
 
+    // Optional list of data streams to add events to, instead of just the selected stream.
+    addStringParameter(Parameter::PROCESSOR_SCOPE, "streams",
+        "Streams",
+        "Comma-separated ids of data streams to add events to, or blank for just the selected stream",
+        "",
+        true);
+
+    // How many sockets and threads to receive on, sharing the host and port.
+    addIntParameter(Parameter::PROCESSOR_SCOPE, "receivers",
+        "Receivers",
+        "How many sockets and threads to receive on, sharing the port with SO_REUSEPORT where supported",
+        1,
+        1,
+        maxReceiverCount,
+        true);
+
+    // How to acknowledge messages back to clients.
+    Array<String> ackModes;
+    ackModes.add("per message");
+    ackModes.add("none");
+    ackModes.add("coalesced");
+    ackModes.add("on request");
+    addCategoricalParameter(Parameter::PROCESSOR_SCOPE,
+        "ack",
+        "Ack",
+        "How to acknowledge UDP messages: one per message, none, one per client per received batch, or only when the client sets the ack request flag",
+        ackModes,
+        ACK_PER_MESSAGE,
+        true);
+
+    // How many events can wait between each receiver thread and process().
+    addIntParameter(Parameter::PROCESSOR_SCOPE, "queue",
+        "Queue",
+        "How many events can wait for processing, for each receiver, before the overflow policy drops some",
+        4096,
+        16,
+        1 << 20,
+        true);
+
+    // What to drop when the queue is at its limit.
+    Array<String> overflowPolicies;
+    overflowPolicies.add("drop newest");
+    overflowPolicies.add("drop oldest");
+    overflowPolicies.add("drop text first");
+    addCategoricalParameter(Parameter::PROCESSOR_SCOPE,
+        "overflow",
+        "Overflow",
+        "What to drop when more events arrive than the queue limit: arriving events, the oldest waiting events, or waiting text events before TTL events",
+        overflowPolicies,
+        OVERFLOW_DROP_NEWEST,
+        true);
+
+    // Socket receive buffer size, to hold bursts until a receiver thread reads them.
+    addIntParameter(Parameter::PROCESSOR_SCOPE, "rcvbuf",
+        "Rcvbuf KB",
+        "Socket receive buffer size for each receiver, in kilobytes, or 0 for the system default",
+        0,
+        0,
+        1 << 20,
+        true);
+
+    // Optional kernel busy polling, for lower latency at the cost of CPU.
+    addIntParameter(Parameter::PROCESSOR_SCOPE, "busypoll",
+        "Busy us",
+        "How long the kernel may busy poll for messages on each read, in microseconds, or 0 for none (Linux only)",
+        0,
+        0,
+        10000,
+        true);
+
+    // Optional real-time scheduling, so receiver threads don't wait behind the GUI and recording threads.
+    addIntParameter(Parameter::PROCESSOR_SCOPE, "rtprio",
+        "RT prio",
+        "Real-time SCHED_FIFO priority for receiver threads, 1-99, which also locks their buffers in memory, or 0 for default scheduling",
+        0,
+        0,
+        99,
+        true);
+
+    // Optional CPUs to keep receiver threads on.
+    addStringParameter(Parameter::PROCESSOR_SCOPE, "cpus",
+        "CPUs",
+        "Comma-separated CPUs or ranges, like 2,3 or 4-7, to run receiver threads on, or blank for any CPU (not on macOS)",
+        "",
+        true);
+
+    // How many recent sync pairs to fit when estimating clock offset and drift.
+    addIntParameter(Parameter::PROCESSOR_SCOPE, "window",
+        "Window",
+        "How many recent sync pairs to fit for clock offset and drift",
+        16,
+        2,
+        10000,
+        true);
+
+    // How long to hold back events that arrive before any sync estimate can convert them.
+    addIntParameter(Parameter::PROCESSOR_SCOPE, "holdback",
+        "Hold ms",
+        "How long to hold back events that arrive before a sync estimate, in milliseconds (0 to drop them right away)",
+        5000,
+        0,
+        600000,
+        true);
+
+    // How far ahead of the current block to carry TTL events forward, so events with bad timestamps can't wait forever.
+    addIntParameter(Parameter::PROCESSOR_SCOPE, "horizon",
+        "Horizon ms",
+        "Drop TTL events that align more than this many milliseconds ahead of the current block",
+        10000,
+        0,
+        3600000,
+        true);
+
+    // Whether to write sync pairs and event alignments to a binary file in each recording directory.
+    addBooleanParameter(Parameter::PROCESSOR_SCOPE, "sidecar",
+        "Sidecar",
+        "Write sync pairs and event sample numbers to a binary sidecar file in the recording directory",
+        false,
+        true);
+
+    // How many sync estimates to keep for converting older events.
+    addIntParameter(Parameter::PROCESSOR_SCOPE, "history",
+        "History",
+        "How many recent sync estimates to keep, evicting the oldest",
+        1024,
+        1,
+        1000000,
+        true);
+
+    // How far off a sync pair must be, in multiples of typical fit error, to reject it as an outlier.
+    addIntParameter(Parameter::PROCESSOR_SCOPE, "outlier",
+        "Outlier",
+        "Reject sync pairs further than this many times the typical fit error from the fit",
+        5,
+        1,
+        1000,
+        true);
+
     // Real TTL line to use for sync events.
     Array<String> syncLines;
     for (int i = 1; i <= 256; i++)
@@ -102,6 +267,10 @@ void UDPEventsPlugin::parameterValueChanged(Parameter* param)
     {
         hostToBind = param->getValueAsString();
     }
+    else if (param->getName().equalsIgnoreCase("group"))
+    {
+        multicastGroup = param->getValueAsString().trim();
+    }
     else if (param->getName().equalsIgnoreCase("port"))
     {
         portToBind = (uint16)(int)param->getValue();
@@ -109,34 +278,181 @@ void UDPEventsPlugin::parameterValueChanged(Parameter* param)
     else if (param->getName().equalsIgnoreCase("stream"))
     {
         streamId = (uint16)(int)param->getValue();
+        updateStreamRoutes();
+    }
+    else if (param->getName().equalsIgnoreCase("streams"))
+    {
+        streamsToRoute = param->getValueAsString();
+        updateStreamRoutes();
+    }
+    else if (param->getName().equalsIgnoreCase("receivers"))
+    {
+        receiverCount = jlimit(1, maxReceiverCount, (int)param->getValue());
+    }
+    else if (param->getName().equalsIgnoreCase("ack"))
+    {
+        // The categories above are in the same order as UDPEventsAckMode.
+        ackMode = (UDPEventsAckMode)(int)param->getValue();
+    }
+    else if (param->getName().equalsIgnoreCase("queue"))
+    {
+        softEventQueueLimit = (int)param->getValue();
+    }
+    else if (param->getName().equalsIgnoreCase("overflow"))
+    {
+        // The categories above are in the same order as UDPEventsOverflowPolicy.
+        overflowPolicy = (UDPEventsOverflowPolicy)(int)param->getValue();
+    }
+    else if (param->getName().equalsIgnoreCase("rcvbuf"))
+    {
+        receiveBufferKilobytes = (int)param->getValue();
+    }
+    else if (param->getName().equalsIgnoreCase("busypoll"))
+    {
+        busyPollMicros = (int)param->getValue();
+    }
+    else if (param->getName().equalsIgnoreCase("rtprio"))
+    {
+        realtimePriority = (int)param->getValue();
+    }
+    else if (param->getName().equalsIgnoreCase("cpus"))
+    {
+        receiverCpus = param->getValueAsString();
+    }
+    else if (param->getName().equalsIgnoreCase("window"))
+    {
+        syncWindow = (int)param->getValue();
+    }
+    else if (param->getName().equalsIgnoreCase("holdback"))
+    {
+        holdBackMillis = (int)param->getValue();
+    }
+    else if (param->getName().equalsIgnoreCase("horizon"))
+    {
+        horizonMillis = (int)param->getValue();
+    }
+    else if (param->getName().equalsIgnoreCase("sidecar"))
+    {
+        writeSidecar = (bool)param->getValue();
+    }
+    else if (param->getName().equalsIgnoreCase("history"))
+    {
+        syncHistoryCapacity = (int)param->getValue();
+    }
+    else if (param->getName().equalsIgnoreCase("outlier"))
+    {
+        outlierThreshold = (int)param->getValue();
     }
     else if (param->getName().equalsIgnoreCase("line"))
     {
         // The UI presents 1-based line numbers 1-256 but internal code uses 0-based 0-255.
         // Looks like getValue() for a categorical parameter gives the selection index.
         // Because of how we set up the categories above, selection index works as the 0-based line number.
-        syncLine = (uint8)(int)param->getValue();
+        auto found = routesByStreamId.find(param->getStreamId());
+        if (found != routesByStreamId.end())
+        {
+            found->second->syncFilter.line = (uint8)(int)param->getValue();
+        }
     }
     else if (param->getName().equalsIgnoreCase("state"))
     {
-        syncStateIndex = (uint8)(int)param->getValue();
+        auto found = routesByStreamId.find(param->getStreamId());
+        if (found != routesByStreamId.end())
+        {
+            found->second->syncFilter.stateIndex = (uint8)(int)param->getValue();
+        }
     }
 }
 
 bool UDPEventsPlugin::startAcquisition()
 {
-    /** Start with fresh sync estimates each acquisition.*/
-    workingSync.clear();
-    syncEstimates.clear();
+    /** Start with fresh sync estimates and clock fit for each stream, each acquisition.*/
+    for (auto &route : streamRoutes)
+    {
+        route->workingSync.clear();
+        route->syncEstimates.configure(syncHistoryCapacity);
+        route->clockModel.configure(syncWindow, outlierThreshold);
+        route->pendingEvents.configure(softEventQueueLimit);
+        route->scheduledEvents.configure(softEventQueueLimit);
+    }
+    if (streamRoutes.empty())
+    {
+        LOGE("UDP Events has no data streams with TTL channels to add events to.");
+    }
 
-    /** UDP socket and buffer lifecycle will match GUI acquisition periods. */
-    startThread();
-    return isThreadRunning();
+    /** Format hot-path logging on a background thread, while acquisition is running. */
+    UDPEventsLog::start(logToOpenEphys);
+    stats.clear();
+    latency.clear();
+
+    /** UDP sockets, buffers, and event queues will match GUI acquisition periods. */
+    receivers.clear();
+    int receiversToOpen = receiverCount;
+    if (multicastGroup.isNotEmpty() && receiversToOpen > 1)
+    {
+        // Each socket in the group gets its own copy of every message, so extra receivers would only add duplicates.
+        LOGC("UDP Events will use one receiver for multicast group: ", multicastGroup);
+        receiversToOpen = 1;
+    }
+    const bool reusePort = receiversToOpen > 1;
+    unsigned long long cpuMask = 0;
+    if (!threadParseCpuList(receiverCpus.toRawUTF8(), &cpuMask))
+    {
+        LOGE("UDP Events can't use CPUs: ", receiverCpus, " and will run receivers on any CPU.");
+        cpuMask = 0;
+    }
+    uint16 port = portToBind;
+    for (int i = 0; i < receiversToOpen; i++)
+    {
+        auto receiver = std::make_unique<UDPEventsReceiver>((uint8)i, ackMode, softEventQueueLimit, overflowPolicy, softEventTextCapacity, stats, latency);
+        receiver->setSocketOptions(receiveBufferKilobytes * 1024, busyPollMicros);
+        receiver->setThreadOptions(realtimePriority, cpuMask);
+        if (!receiver->open(hostToBind, port, reusePort, multicastGroup))
+        {
+            // Keep going with the receivers we have, like when a single receiver can't bind.
+            break;
+        }
+
+        // If the system assigned a port, the rest of the receivers should share it.
+        port = receiver->getBoundPort();
+        receivers.push_back(std::move(receiver));
+    }
+    if ((int)receivers.size() < receiversToOpen)
+    {
+        LOGE("UDP Events opened ", (int)receivers.size(), " of ", receiversToOpen, " receivers.");
+    }
+
+    bool started = true;
+    for (auto &receiver : receivers)
+    {
+        receiver->startThread();
+        started = started && receiver->isThreadRunning();
+    }
+    return started;
 }
 
 bool UDPEventsPlugin::stopAcquisition()
 {
-    if (!stopThread(1000))
+    // Ask all the receivers to exit first, so they can wind down together.
+    for (auto &receiver : receivers)
+    {
+        receiver->signalStop();
+    }
+
+    bool stopped = true;
+    for (auto &receiver : receivers)
+    {
+        stopped = receiver->stopThread(1000) && stopped;
+    }
+
+    // In case acquisition stopped before recording did.
+    closeSidecar();
+
+    // Flush any remaining log lines, then say where the time went.
+    UDPEventsLog::stop();
+    logLatencyReport();
+
+    if (!stopped)
     {
         LOGE("UDP Events Thread timed out when trying ot stop.  Forcing termination, so things might be unstable going forward.");
         return false;
@@ -144,253 +460,526 @@ bool UDPEventsPlugin::stopAcquisition()
     return true;
 }
 
-void UDPEventsPlugin::run()
+EventChannel *UDPEventsPlugin::findTTLChannel(uint16 streamIdToFind)
+{
+    for (auto eventChannel : eventChannels)
+    {
+        if (eventChannel->getType() == EventChannel::Type::TTL && eventChannel->getStreamId() == streamIdToFind)
+        {
+            return eventChannel;
+        }
+    }
+    return nullptr;
+}
+
+void UDPEventsPlugin::updateSettings()
 {
-    LOGC("UDP Events Thread is starting.");
+    updateStreamRoutes();
+}
 
-    // Create a new UDP socket to receive on.
-    int serverSocket = udpOpenSocket();
-    if (serverSocket < 0)
+void UDPEventsPlugin::updateStreamRoutes()
+{
+    // Which streams to route to: the configured list, or else the selected stream.
+    Array<uint16> streamIdsToRoute;
+    for (auto token : StringArray::fromTokens(streamsToRoute, ", ", ""))
     {
-        LOGE("UDP Events Thread error creating socket: ", udpErrorMessage());
-        return;
+        if (token.isNotEmpty())
+        {
+            streamIdsToRoute.addIfNotAlreadyThere((uint16)token.getIntValue());
+        }
+    }
+    if (streamIdsToRoute.isEmpty())
+    {
+        streamIdsToRoute.add(streamId);
     }
 
-    // Bind the local address and port so we can receive, as a server.
-    struct UdpAddress addressToBind;
-    addressToBind.port = portToBind;
-    hostToBind.copyToUTF8(addressToBind.hostName, sizeof(addressToBind.hostName));
-    udpHostNameToBin(&addressToBind);
-    int bindResult = udpBind(serverSocket, &addressToBind);
-    if (bindResult < 0)
+    // Look up each stream's sample rate, TTL channel, and sync settings once, here, instead of on every block.
+    streamRoutes.clear();
+    routesByStreamId.clear();
+    for (auto stream : dataStreams)
     {
-        udpCloseSocket(serverSocket);
-        LOGE("UDP Events Thread could not bind socket to address: ", hostToBind, " port: ", portToBind, " error: ", udpErrorMessage());
-        return;
+        const uint16 routeStreamId = stream->getStreamId();
+        if (!streamIdsToRoute.contains(routeStreamId))
+        {
+            continue;
+        }
+
+        EventChannel *ttlChannel = findTTLChannel(routeStreamId);
+        if (ttlChannel == nullptr)
+        {
+            LOGC("UDP Events can't route to stream ", routeStreamId, " because it has no TTL channel.");
+            continue;
+        }
+
+        auto route = std::make_unique<StreamRoute>();
+        route->streamId = routeStreamId;
+        route->sampleRate = stream->getSampleRate();
+        route->ttlChannel = ttlChannel;
+        route->syncFilter.line = (uint8)(int)(*stream)["line"];
+        route->syncFilter.stateIndex = (uint8)(int)(*stream)["state"];
+        routesByStreamId[routeStreamId] = route.get();
+        streamRoutes.push_back(std::move(route));
     }
+}
 
-    // Report the address and port we actually bound (they might have been assigned by system).
-    struct UdpAddress boundAddress;
-    udpGetAddress(serverSocket, &boundAddress);
-    udpHostBinToName(&boundAddress);
-    LOGC("UDP Events Thread is ready to receive at address: ", boundAddress.hostName, " port: ", boundAddress.port);
+void UDPEventsPlugin::process(AudioBuffer<float> &buffer)
+{
+    // Hold on to the sidecar for this whole block, so stopRecording() can wait until we're done with it to close it.
+    // These are sequentially consistent, so either stopRecording() sees we're using it, or we see it's no longer wanted.
+    sidecarInUse.store(true);
+    sidecarActive = sidecarWanted.load();
+
+    // This synchronously calls back to handleTTLEvent(), below.
+    checkForEvents();
 
-    // Read the client addresses and messages text into local buffers.
-    struct UdpAddress clientAddress;
-    char messageBuffer[65536] = {0};
-    while (!threadShouldExit())
+    // Add TTL events carried forward from earlier blocks that belong in this one.
+    for (auto &route : streamRoutes)
     {
-        // Wait for a message to arrive, but wake every 100ms to remain responsive to exit requests.
-        bool messageArrived = udpAwaitMessage(serverSocket, 100);
-        if (messageArrived)
+        if (!route->scheduledEvents.empty())
         {
-            int bytesRead = udpReceiveFrom(serverSocket, &clientAddress, messageBuffer, sizeof(messageBuffer));
-            if (bytesRead <= 0)
-            {
-                LOGE("UDP Events Thread had a read error.  Bytes read: ", bytesRead, " error: ", udpErrorMessage());
-                continue;
-            }
-
-            // Record a timestamp close to when we got the UDP message.
-            const int64 serverSecs = (double)CoreServices::getSystemTime(); 
+            const int64 blockEnd = getFirstSampleNumberForBlock(route->streamId) + getNumSamplesInBlock(route->streamId);
+            route->scheduledEvents.releaseBefore(blockEnd, [&](const SoftEvent &scheduledEvent, int64 sampleNumber) {
+                addTTLEventAtSample(*route, scheduledEvent, sampleNumber, scheduledEvent.stageNanos);
+            });
+        }
+    }
 
-            // Who sent us this message?
-            udpHostBinToName(&clientAddress);
-            LOGC("UDP Events Thread received ", bytesRead, " bytes from host: ", clientAddress.hostName, " port: ", clientAddress.port);
+    // Work through soft messages enqueued by the UDP receiver threads, in client timestamp order across receivers.
+    // This reads events in place and never waits on a UDP Thread.
+    uint64 textReleaseOffsets[maxReceiverCount] = {};
+    UDPEventsReceiver *fromReceiver = nullptr;
+    while (SoftEvent *nextEvent = nextSoftEvent(fromReceiver))
+    {
+        // Note how long the event waited in the queue, and start timing the next stage.
+        const int64 dequeueNanos = UDPEventsLatency::nowNanos();
+        latency.record(LATENCY_QUEUE, dequeueNanos - nextEvent->stageNanos);
+        nextEvent->stageNanos = dequeueNanos;
 
-            // Acknowledge message receipt to the client.
-            int bytesWritten = udpSendTo(serverSocket, &clientAddress, (const char *)&serverSecs, 8);
-            if (bytesWritten < 0)
+        const SoftEvent &softEvent = *nextEvent;
+        if (softEvent.streamId != 0)
+        {
+            // The client targeted one stream.
+            auto found = routesByStreamId.find(softEvent.streamId);
+            if (found != routesByStreamId.end())
             {
-                LOGE("UDP Events Thread had a write error.  Bytes written: ", bytesWritten, " error: ", udpErrorMessage());
-                continue;
+                handleSoftEvent(*found->second, softEvent);
             }
-            LOGC("UDP Events Thread sent ", bytesWritten, " bytes to host: ", clientAddress.hostName, " port: ", clientAddress.port);
-
-            // Process the message itself.
-            uint8 messageType = (uint8)messageBuffer[0];
-            if (messageType == 1)
+            else
             {
-                // This is a TTL message.
-                SoftEvent ttlEvent;
-                ttlEvent.type = 1;
-                ttlEvent.clientSeconds = *((double *)(messageBuffer + 1));
-                ttlEvent.systemTimeMilliseconds = serverSecs;
-                ttlEvent.lineNumber = (uint8)messageBuffer[9];
-                ttlEvent.lineState = (uint8)messageBuffer[10];
-
-                LOGC("UDP Events Thread got a TTL message with client timestamp: ", ttlEvent.clientSeconds, " 0-based line number: ", (int)ttlEvent.lineNumber, " line state: ", (int)ttlEvent.lineState);
-
-                // Enqueue this to be handled below, on the main thread, in process().
-                {
-                    ScopedLock TTLlock(softEventQueueLock);
-                    softEventQueue.push(ttlEvent);
-                }
+                UDPEVENTS_COUNT(UDPEventsLog::LEVEL_ERROR, "UDP Events dropped {} events in the last second that targeted streams with no route", 1);
+                stats.add(STAT_EVENTS_DROPPED_NO_ROUTE);
             }
-            else if (messageType == 2)
+        }
+        else if (!streamRoutes.empty())
+        {
+            // Add the event to all routed streams.
+            for (auto &route : streamRoutes)
             {
-                // This is a Text message.
-                SoftEvent textEvent;
-                textEvent.type = 2;
-                textEvent.clientSeconds = *((double *)(messageBuffer + 1));
-                textEvent.systemTimeMilliseconds = serverSecs;
-                textEvent.textLength = udpNToHS(*((uint16 *)(messageBuffer + 9)));
-                textEvent.text = String::fromUTF8(messageBuffer + 11, textEvent.textLength);
-
-                LOGC("UDP Events Thread got a Text message with client timestamp: ", textEvent.clientSeconds, " message length: ", (int)textEvent.textLength, " message: ", textEvent.text);
-
-                // Enqueue this to be handled below, on the main thread, in process().
-                {
-                    ScopedLock TTLlock(softEventQueueLock);
-                    softEventQueue.push(textEvent);
-                }
+                handleSoftEvent(*route, softEvent);
             }
-            else
+        }
+        else
+        {
+            UDPEVENTS_COUNT(UDPEventsLog::LEVEL_ERROR, "UDP Events dropped {} events in the last second with no stream to route them to", 1);
+            stats.add(STAT_EVENTS_DROPPED_NO_ROUTE);
+        }
+
+        // Pop releases the slot for the UDP Thread to reuse -- so wait until we're done.
+        textReleaseOffsets[softEvent.source] = jmax(textReleaseOffsets[softEvent.source], softEvent.textArenaEnd());
+        fromReceiver->getQueue().pop();
+    }
+
+    // Sync estimates from this block might cover events we held back earlier.
+    bool anyHeld = false;
+    for (auto &route : streamRoutes)
+    {
+        if (!route->pendingEvents.empty())
+        {
+            releasePendingEvents(*route);
+            anyHeld = anyHeld || !route->pendingEvents.empty();
+        }
+    }
+
+    // Recycle arena storage for all the text we just processed, in one go -- except text for events still held back.
+    for (size_t source = 0; source < receivers.size(); source++)
+    {
+        uint64 releaseOffset = textReleaseOffsets[source];
+        if (anyHeld)
+        {
+            for (auto &route : streamRoutes)
             {
-                // This seems to be some unexpected message, and we'll ignore it.
-                LOGE("UDP Events Thread ignoring message of unknown type ", (int)messageType, " and byte size ", bytesRead);
+                releaseOffset = jmin(releaseOffset, route->pendingEvents.oldestTextArenaOffset((uint8)source));
             }
         }
+        receivers[source]->getTextArena().releaseUpTo(releaseOffset);
     }
 
-    // The main loop has exited so we're done, so clean up and let the UDP thread terminate.
-    udpCloseSocket(serverSocket);
-    LOGC("UDP Events Thread is stopping.");
+    // Publish gauges once per block.
+    size_t queueDepth = 0;
+    size_t queueMaxDepth = 0;
+    for (auto &receiver : receivers)
+    {
+        queueDepth += receiver->getQueue().size();
+        queueMaxDepth = jmax(queueMaxDepth, receiver->getQueue().maxOccupancy());
+    }
+    size_t pendingCount = 0;
+    size_t estimateCount = 0;
+    for (auto &route : streamRoutes)
+    {
+        pendingCount += route->pendingEvents.size() + route->scheduledEvents.size();
+        estimateCount += route->syncEstimates.size();
+    }
+    stats.set(STAT_QUEUE_DEPTH, queueDepth);
+    stats.set(STAT_QUEUE_MAX_DEPTH, queueMaxDepth);
+    stats.set(STAT_PENDING_EVENTS, pendingCount);
+    stats.set(STAT_SYNC_ESTIMATES, estimateCount);
+
+    sidecarInUse.store(false, std::memory_order_release);
 }
 
-EventChannel *UDPEventsPlugin::pickTTLChannel()
+SoftEvent *UDPEventsPlugin::nextSoftEvent(UDPEventsReceiver *&fromReceiver)
 {
-    for (auto eventChannel : eventChannels)
+    // Each receiver's queue keeps its clients' messages in arrival order, so only compare the front of each.
+    SoftEvent *earliest = nullptr;
+    for (auto &receiver : receivers)
     {
-        if (eventChannel->getType() == EventChannel::Type::TTL && eventChannel->getStreamId() == streamId)
+        SoftEvent *front = receiver->getQueue().front();
+        if (front != nullptr && (earliest == nullptr || front->clientSeconds < earliest->clientSeconds))
         {
-            return eventChannel;
+            earliest = front;
+            fromReceiver = receiver.get();
         }
     }
-    return nullptr;
+    return earliest;
 }
 
-void UDPEventsPlugin::process(AudioBuffer<float> &buffer)
+void UDPEventsPlugin::handleSoftEvent(StreamRoute &route, const SoftEvent &softEvent)
 {
-    // This synchronously calls back to handleTTLEvent(), below.
-    checkForEvents();
+    if (softEvent.type == SOFT_EVENT_TYPE_TTL && route.syncFilter.matches(softEvent.lineNumber, (bool)softEvent.lineState))
+    {
+        UDPEVENTS_TRACE(UDPEventsLog::LEVEL_INFO, "UDP Events recording soft TTL sync info for stream: {} on 0-based line: {} state: {} client soft secs {}", route.streamId, softEvent.lineNumber, (bool)softEvent.lineState, softEvent.clientSeconds);
 
-    // Find the selected data stream.
-    for (auto stream : dataStreams)
+        // This is a soft sync event corresponding to a real TTL event.
+        bool syncComplete = route.workingSync.recordSoftTimestamp(softEvent.clientSeconds, route.sampleRate);
+        if (syncComplete)
+        {
+            // The working sync has seen both a real and a soft event.
+            completeSyncEstimate(route);
+        }
+    }
+    else if (softEvent.type == SOFT_EVENT_TYPE_TTL || softEvent.type == SOFT_EVENT_TYPE_TEXT)
     {
-        if (stream->getStreamId() == streamId)
+        // This is a soft TTL or Text event to add to the stream.
+        // We'll add it if we can find a previous sync estimate, otherwise hold it back until we can.
+        int64 sampleNumber = softSampleNumber(route, softEvent.clientSeconds);
+        if (sampleNumber)
         {
-            // Find a TTL channel for the selected data stream.
-            EventChannel *ttlChannel = pickTTLChannel();
-            if (ttlChannel == nullptr)
+            addSoftEvent(route, softEvent, sampleNumber);
+        }
+        else
+        {
+            holdBackSoftEvent(route, softEvent);
+        }
+    }
+}
+
+void UDPEventsPlugin::addSoftEvent(StreamRoute &route, const SoftEvent &softEvent, int64 sampleNumber)
+{
+    // The event's sample number is known as of now, whether it was held back or not.
+    // Events can go to several routes, so only time sync and total latency on the first, to count each event once.
+    const int64 resolvedNanos = UDPEventsLatency::nowNanos();
+    if (softEvent.streamId != 0 || &route == streamRoutes.front().get())
+    {
+        latency.record(LATENCY_SYNC, resolvedNanos - softEvent.stageNanos);
+        latency.record(LATENCY_TOTAL, udpSystemTimeNanos() - softEvent.receiveNanos);
+    }
+
+    if (softEvent.type == SOFT_EVENT_TYPE_TTL)
+    {
+        // Events for a later block wait in the scheduler until process() gets to that block.
+        const int64 firstSample = getFirstSampleNumberForBlock(route.streamId);
+        const int64 blockEnd = firstSample + getNumSamplesInBlock(route.streamId);
+        if (sampleNumber >= blockEnd)
+        {
+            // Don't let events with far-off timestamps sit in the scheduler for the rest of acquisition.
+            const int64 horizonSamples = (int64)horizonMillis * (int64)route.sampleRate / 1000;
+            if (sampleNumber - firstSample > horizonSamples)
             {
+                UDPEVENTS_COUNT(UDPEventsLog::LEVEL_ERROR, "UDP Events dropped {} TTL events in the last second that aligned past the horizon", 1);
+                stats.add(STAT_EVENTS_DROPPED_PAST_HORIZON);
                 return;
             }
 
-            // Work through soft messages enqueued above, by run() on the UDP Thread.
+            SoftEvent scheduledEvent = softEvent;
+            scheduledEvent.stageNanos = resolvedNanos;
+            if (!route.scheduledEvents.add(scheduledEvent, sampleNumber))
             {
-                ScopedLock TTLlock(softEventQueueLock);
-                while (!softEventQueue.empty())
-                {
-                    const SoftEvent &softEvent = softEventQueue.front();
-                    if (softEvent.type == 1)
-                    {
-                        // This is a TTL message.
-                        if (filterSyncEvent(softEvent.lineNumber, (bool)softEvent.lineState))
-                        {
-                            LOGC("UDP Events recording soft TTL sync info on 0-based line: ", (int)softEvent.lineNumber, " state: ", (bool)softEvent.lineState, " client soft secs ", softEvent.clientSeconds);
-
-                            // This is a soft sync event corresponding to a real TTL event.
-                            bool syncComplete = workingSync.recordSoftTimestamp(softEvent.clientSeconds, stream->getSampleRate());
-                            if (syncComplete)
-                            {
-                                // The working sync has seen both a real and a soft event.
-                                // Record it as an event, add it to the sync history, and start a new sync going forward.
-                                addEventForSyncEstimate(workingSync);
-                                syncEstimates.push_back(workingSync);
-                                workingSync.clear();
-                            }
-                        }
-                        else
-                        {
-                            // This is a soft TTL event to add to the selected stream.
-                            // We'll add it, if we can find a previous sync estimate.
-                            int64 sampleNumber = softSampleNumber(softEvent.clientSeconds, stream->getSampleRate());
-                            if (sampleNumber)
-                            {
-                                TTLEventPtr ttlEvent = TTLEvent::createTTLEvent(ttlChannel,
-                                                                                softEvent.systemTimeMilliseconds,
-                                                                                softEvent.lineNumber,
-                                                                                softEvent.lineState);
-                                addEvent(ttlEvent, 0);
-                            }
-                        }
-                    }
-                    else if (softEvent.type == 2)
-                    {
-                        // This is a Text message to add to the selected stream.
-                        // We'll add it, if we can find a previous sync estimate.
-                        int64 sampleNumber = softSampleNumber(softEvent.clientSeconds, stream->getSampleRate());
-                        if (sampleNumber)
-                        {
-                            // Currently Open Ephys persists text events with low, per-block timing precision.
-                            // Append high-precision timing info to the message for later reconstruction.
-                            String messageText = softEvent.text + "@" + String(softEvent.clientSeconds, 8, false) + "=" + String(sampleNumber);
-                            TextEventPtr textEvent = TextEvent::createTextEvent(getMessageChannel(),
-                                                                                softEvent.systemTimeMilliseconds,
-                                                                                messageText);
-                            //LOGC("Regular text event| type: ", typeid(softEvent.systemTimeMilliseconds).name(), " value: ", softEvent.systemTimeMilliseconds);
-                            addEvent(textEvent, 0);
-                        }
-                    }
-
-                    // Pop invokes destructor of message (and allocated text!) -- so wait until we're done.
-                    softEventQueue.pop();
-                }
+                // Adding the event now would put it at the wrong sample, so drop it instead.
+                UDPEVENTS_COUNT(UDPEventsLog::LEVEL_ERROR, "UDP Events had no room to carry {} TTL events forward in the last second, dropped them", 1);
+                stats.add(STAT_EVENTS_DROPPED_SCHEDULE_FULL);
+                return;
             }
+            UDPEVENTS_COUNT(UDPEventsLog::LEVEL_DEBUG, "UDP Events carried {} TTL events forward to later blocks in the last second", 1);
+            return;
         }
+        addTTLEventAtSample(route, softEvent, sampleNumber, resolvedNanos);
+    }
+    else if (softEvent.type == SOFT_EVENT_TYPE_TEXT)
+    {
+        // Currently Open Ephys persists text events with low, per-block timing precision.
+        // Append high-precision timing info to the message for later reconstruction.
+        String messageText = String::fromUTF8(softEvent.getText(receivers[softEvent.source]->getTextArena()), softEvent.textLength) + "@" + String(softEvent.clientSeconds, 8, false) + "=" + String(sampleNumber);
+        if (streamRoutes.size() > 1)
+        {
+            // Text events don't belong to a stream, so say which stream the sample number is for.
+            messageText += "#" + String(route.streamId);
+        }
+        TextEventPtr textEvent = TextEvent::createTextEvent(getMessageChannel(),
+                                                            softEvent.systemTimeMilliseconds,
+                                                            messageText);
+        addEvent(textEvent, 0);
+        stats.add(STAT_TEXT_EVENTS_ADDED);
+        recordEventAdded(resolvedNanos);
+        appendEventToSidecar(route, softEvent, sampleNumber);
     }
 }
 
-int64 UDPEventsPlugin::softSampleNumber(double softSecs, float localSampleRate)
+void UDPEventsPlugin::addTTLEventAtSample(StreamRoute &route, const SoftEvent &softEvent, int64 sampleNumber, int64 resolvedNanos)
 {
-    // Look for the last completed sync estimate preceeding the given softSecs.
-    for (auto current = syncEstimates.rbegin(); current != syncEstimates.rend(); ++current)
+    // Place the event at its offset within the current block.
+    // Events for an earlier block keep their sample number, but can only go at the start of this one.
+    const int64 firstSample = getFirstSampleNumberForBlock(route.streamId);
+    const int64 lastOffset = jmax<int64>(0, (int64)getNumSamplesInBlock(route.streamId) - 1);
+    if (sampleNumber < firstSample)
     {
-        LOGC("UDP Events has a sync estimate with client soft secs: ", current->syncSoftSecs);
+        UDPEVENTS_COUNT(UDPEventsLog::LEVEL_INFO, "UDP Events added {} TTL events late in the last second, by {} samples total", firstSample - sampleNumber);
+        stats.add(STAT_LATE_TTL_EVENTS);
+    }
+    const int offset = (int)jlimit<int64>(0, lastOffset, sampleNumber - firstSample);
+
+    TTLEventPtr ttlEvent = TTLEvent::createTTLEvent(route.ttlChannel,
+                                                    sampleNumber,
+                                                    softEvent.lineNumber,
+                                                    softEvent.lineState);
+    addEvent(ttlEvent, offset);
+    stats.add(STAT_TTL_EVENTS_ADDED);
+    recordEventAdded(resolvedNanos);
+    appendEventToSidecar(route, softEvent, sampleNumber);
+}
+
+void UDPEventsPlugin::recordEventAdded(int64 resolvedNanos)
+{
+    latency.record(LATENCY_EMIT, UDPEventsLatency::nowNanos() - resolvedNanos);
+}
 
-        if (current->syncSoftSecs <= softSecs)
+void UDPEventsPlugin::logLatencyReport()
+{
+    for (int i = 0; i < LATENCY_STAGE_COUNT; i++)
+    {
+        const UDPEventsLatencyStage stage = (UDPEventsLatencyStage)i;
+        const LatencyHistogram &histogram = latency.get(stage);
+        if (histogram.count() == 0)
         {
-            // This is the most relevant sync estimate.
-            return current->softSampleNumber(softSecs, localSampleRate);
+            continue;
         }
+        LOGC("UDP Events latency ", UDPEventsLatency::name(stage),
+             ": count ", (int64)histogram.count(),
+             " p50 ", String(histogram.percentile(0.5) / 1000.0, 1), " us",
+             " p99 ", String(histogram.percentile(0.99) / 1000.0, 1), " us",
+             " p99.9 ", String(histogram.percentile(0.999) / 1000.0, 1), " us",
+             " max ", String(histogram.max() / 1000.0, 1), " us");
+    }
+}
+
+void UDPEventsPlugin::startRecording()
+{
+    if (!writeSidecar)
+    {
+        return;
+    }
+
+    // Open the file here, off the audio thread, then let process() start appending to it.
+    closeSidecar();
+    File recordingDirectory = CoreServices::getRecordingParentDirectory().getChildFile(CoreServices::getRecordingDirectoryName());
+    recordingDirectory.createDirectory();
+    sidecarPath = recordingDirectory.getChildFile("udp-events-" + String(getNodeId()) + ".sidecar").getNonexistentSibling(false).getFullPathName();
+    if (!sidecar.open(sidecarPath.toRawUTF8(), (uint32)getNodeId(), CoreServices::getSystemTime()))
+    {
+        LOGE("UDP Events could not open sidecar file: ", sidecarPath, " error: ", sidecar.failureMessage());
+        return;
+    }
+    LOGC("UDP Events writing sidecar file: ", sidecarPath);
+    sidecarWanted.store(true);
+}
+
+void UDPEventsPlugin::stopRecording()
+{
+    closeSidecar();
+}
+
+void UDPEventsPlugin::closeSidecar()
+{
+    // Wait for any block in progress to finish appending, then close the file here, off the audio thread.
+    sidecarWanted.store(false);
+    while (sidecarInUse.load())
+    {
+        std::this_thread::yield();
+    }
+    if (!sidecar.isOpen())
+    {
+        return;
+    }
+    if (sidecar.hasFailed())
+    {
+        LOGE("UDP Events could not grow sidecar file: ", sidecarPath, " error: ", sidecar.failureMessage(), ", kept ", (int64)sidecar.recordCount(), " records.");
+    }
+    else
+    {
+        LOGC("UDP Events wrote ", (int64)sidecar.recordCount(), " records to sidecar file: ", sidecarPath);
+    }
+    sidecar.close();
+}
+
+void UDPEventsPlugin::appendEventToSidecar(const StreamRoute &route, const SoftEvent &softEvent, int64 sampleNumber)
+{
+    if (!sidecarActive)
+    {
+        return;
+    }
+    SidecarRecord record = {};
+    record.kind = softEvent.type == SOFT_EVENT_TYPE_TTL ? SIDECAR_TTL_EVENT : SIDECAR_TEXT_EVENT;
+    record.line = softEvent.lineNumber;
+    record.state = softEvent.lineState;
+    record.streamId = route.streamId;
+    record.textLength = softEvent.textLength;
+    record.clientSeconds = softEvent.clientSeconds;
+    record.sampleNumber = sampleNumber;
+    record.receiveNanos = softEvent.receiveNanos;
+    appendToSidecar(record);
+}
+
+void UDPEventsPlugin::appendToSidecar(const SidecarRecord &record)
+{
+    if (sidecar.append(record))
+    {
+        return;
+    }
+    if (sidecar.hasFailed())
+    {
+        // The file couldn't grow, like when the disk is full.  Stop writing for the rest of this recording, and let closeSidecar() say why.
+        sidecarActive = false;
+        sidecarWanted.store(false);
+        UDPEVENTS_TRACE(UDPEventsLog::LEVEL_ERROR, "UDP Events stopped writing the sidecar file after {} records, because it could not grow", (int64)sidecar.recordCount());
+        return;
+    }
+    UDPEVENTS_COUNT(UDPEventsLog::LEVEL_ERROR, "UDP Events could not write {} sidecar records in the last second", 1);
+}
+
+void UDPEventsPlugin::holdBackSoftEvent(StreamRoute &route, const SoftEvent &softEvent)
+{
+    if (holdBackMillis <= 0 || !route.pendingEvents.add(softEvent, softEvent.systemTimeMilliseconds + holdBackMillis))
+    {
+        UDPEVENTS_COUNT(UDPEventsLog::LEVEL_ERROR, "UDP Events dropped {} events in the last second with no sync estimate and no room to hold them back", 1);
+        stats.add(STAT_EVENTS_DROPPED_NO_SYNC);
+        return;
+    }
+    UDPEVENTS_COUNT(UDPEventsLog::LEVEL_INFO, "UDP Events held back {} events in the last second, waiting for a sync estimate", 1);
+    stats.add(STAT_EVENTS_HELD_BACK);
+}
+
+void UDPEventsPlugin::releasePendingEvents(StreamRoute &route)
+{
+    // Release events the sync history now covers, in client time order, which is also sample order.
+    size_t released = route.pendingEvents.releaseFrom(route.syncEstimates.earliestConvertibleSecs(), [&](const SoftEvent &heldEvent) {
+        addSoftEvent(route, heldEvent, softSampleNumber(route, heldEvent.clientSeconds));
+    });
+    if (released > 0)
+    {
+        UDPEVENTS_COUNT(UDPEventsLog::LEVEL_INFO, "UDP Events released {} batches with {} held-back events in the last second", (int64)released);
+        stats.add(STAT_EVENTS_RELEASED, released);
+    }
+
+    // Give up on events that waited too long.
+    size_t expired = route.pendingEvents.expire(CoreServices::getSystemTime(), [](const SoftEvent &) {});
+    if (expired > 0)
+    {
+        UDPEVENTS_COUNT(UDPEventsLog::LEVEL_ERROR, "UDP Events dropped {} batches with {} held-back events in the last second that waited too long for a sync estimate", (int64)expired);
+        stats.add(STAT_EVENTS_EXPIRED, expired);
+    }
+}
+
+int64 UDPEventsPlugin::softSampleNumber(StreamRoute &route, double softSecs)
+{
+    // Look for the last completed sync estimate preceeding the given softSecs.
+    const SyncEstimate *estimate = route.syncEstimates.find(softSecs);
+    if (estimate != nullptr)
+    {
+        // This is the most relevant sync estimate.
+        return estimate->softSampleNumber(softSecs, route.sampleRate);
     }
 
     // No relevant sync estimates.
-    LOGE("UDP Events has no good sync estimate preceeding client soft secs: ", softSecs);
+    UDPEVENTS_TRACE(UDPEventsLog::LEVEL_DEBUG, "UDP Events has no good sync estimate for stream: {} preceeding client soft secs: {}", route.streamId, softSecs);
     return 0;
 }
 
-bool UDPEventsPlugin::filterSyncEvent(uint8 line, bool state)
+void UDPEventsPlugin::completeSyncEstimate(StreamRoute &route)
 {
-    switch (syncStateIndex)
-    {
-    case 1:
-        // syncStateIndex 1 means use only high state.
-        return line == syncLine && state;
-    case 2:
-        // syncStateIndex 2 means use only low state.
-        return line == syncLine && !state;
-    default:
-        // syncStateIndex 0 (or other) means use either state.
-        return line == syncLine;
+    // Update the clock fit with this pair, unless it looks like an outlier.
+    SyncEstimate &workingSync = route.workingSync;
+    bool accepted = route.clockModel.addPair(workingSync.syncSoftSecs, workingSync.syncLocalSampleNumber, route.sampleRate);
+    stats.add(accepted ? STAT_SYNC_PAIRS : STAT_SYNC_OUTLIERS);
+    if (accepted)
+    {
+        workingSync.recordClockFit(route.clockModel);
+    }
+
+    // Record it as an event, add it to the sync history, and start a new sync going forward.
+    addEventForSyncEstimate(route, workingSync, accepted);
+    if (sidecarActive)
+    {
+        SidecarRecord record = {};
+        record.kind = accepted ? SIDECAR_SYNC_PAIR : SIDECAR_SYNC_OUTLIER;
+        record.line = route.syncFilter.line;
+        record.streamId = route.streamId;
+        record.clientSeconds = workingSync.syncSoftSecs;
+        record.sampleNumber = workingSync.syncLocalSampleNumber;
+        record.receiveNanos = workingSync.syncLocalTimestamp * 1000000;
+        if (route.clockModel.hasFit())
+        {
+            record.fitSampleNumber = route.clockModel.predict(workingSync.syncSoftSecs);
+            record.fitSamplesPerSecond = route.clockModel.samplesPerSecond();
+            record.fitResidualRms = route.clockModel.residualRms();
+            record.fitPairCount = (uint32)route.clockModel.size();
+        }
+        appendToSidecar(record);
+    }
+    if (accepted)
+    {
+        route.syncEstimates.add(workingSync);
     }
+    workingSync.clear();
 }
 
-void UDPEventsPlugin::addEventForSyncEstimate(struct SyncEstimate syncEstimate)
+void UDPEventsPlugin::addEventForSyncEstimate(const StreamRoute &route, const SyncEstimate &syncEstimate, bool accepted)
 {
-    LOGC("UDP Events adding sync estimate with client soft secs: ", syncEstimate.syncSoftSecs, " local timestamp: ", syncEstimate.syncLocalTimestamp);
-    String text = "UDP Events sync on line " + String(syncLine + 1) + "@" + String(syncEstimate.syncSoftSecs, 8, false) + "=" + String(syncEstimate.syncLocalSampleNumber);
+    UDPEVENTS_TRACE(UDPEventsLog::LEVEL_INFO, "UDP Events adding sync estimate for stream: {} with client soft secs: {} local timestamp: {} accepted: {}", route.streamId, syncEstimate.syncSoftSecs, syncEstimate.syncLocalTimestamp, accepted);
+
+    // Keep the original "UDP Events sync on line <LINE>@<client_soft_timestamp>=<stream_sample_number>" form,
+    // with the stream id after it like other text events when there are several streams, then the clock fit as of this estimate.
+    String text = "UDP Events sync on line " + String(route.syncFilter.line + 1) + "@" + String(syncEstimate.syncSoftSecs, 8, false) + "=" + String(syncEstimate.syncLocalSampleNumber);
+    if (streamRoutes.size() > 1)
+    {
+        text += "#" + String(route.streamId);
+    }
+    if (accepted)
+    {
+        text += " rate " + String(syncEstimate.fitSamplesPerSecond, 6, false) + " rms " + String(route.clockModel.residualRms(), 3, false) + " pairs " + String((int)route.clockModel.size());
+    }
+    else
+    {
+        text += " outlier";
+    }
     TextEventPtr textEvent = TextEvent::createTextEvent(getMessageChannel(),
         syncEstimate.syncLocalTimestamp,
         text);
@@ -402,37 +991,28 @@ void UDPEventsPlugin::handleTTLEvent(TTLEventPtr event)
     // Record a system timestamp for when we got this real ttl event.
     const int64 systemMillisecs = CoreServices::getSystemTime();
 
-	// Check that the event is for the selected line and state.
-    if (filterSyncEvent(event->getLine(), event->getState()))
+    // Look up the route for the event's stream, if any.
+    auto found = routesByStreamId.find(event->getStreamId());
+    if (found == routesByStreamId.end())
     {
-        LOGC("UDP Events saw a real TTL event on 0-based line: ", (int)event->getLine(), " state: ", event->getState());
+        return;
+    }
+    StreamRoute &route = *found->second;
 
+	// Check that the event is for the selected line and state.
+    if (route.syncFilter.matches(event->getLine(), event->getState()))
+    {
         // This real TTL event should corredspond to a soft TTL event.
-        for (auto stream : dataStreams)
+		// Creating text events for GUI v1.0.0 requires system timestamps in milliseconds as opposed to stream sample numbers/timestamps (previous versions)
+        UDPEVENTS_TRACE(UDPEventsLog::LEVEL_INFO, "UDP Events recording real TTL sync info for stream: {} on 0-based line: {} state: {} local timestamp: {}", route.streamId, event->getLine(), event->getState(), systemMillisecs);
+		// Record the local sample number associated with this real sync event to use as a key for offline alignment of other soft messages.
+        route.workingSync.recordLocalSampleNumber(event->getSampleNumber(), route.sampleRate);
+        // Record the system time to finish the sync and add a text sync event at the same time as the real TTL sync pulse.
+        bool completed = route.workingSync.recordLocalTimestamp(systemMillisecs, route.sampleRate);
+        if (completed)
         {
-            if (stream->getStreamId() == streamId)
-            {
-				// Creating text events for GUI v1.0.0 requires system timestamps in milliseconds as opposed to stream sample numbers/timestamps (previous versions)
-                LOGC("UDP Events recording real TTL sync info on 0-based line: ", (int)event->getLine(), " state: ", event->getState(), " local timestamp: ", systemMillisecs);
-				// Record the local sample number associated with this real sync event to use as a key for offline alignment of other soft messages.
-                workingSync.recordLocalSampleNumber(event->getSampleNumber(), stream->getSampleRate());
-                // Record the system time to finish the sync and add a text sync event at the same time as the real TTL sync pulse.
-                bool completed = workingSync.recordLocalTimestamp(systemMillisecs, stream->getSampleRate());
-                if (completed)
-                {
-                    // The working sync has seen both a real and a soft event.
-                    // Record it as an event, add it to the sync history, and start a new sync going forward.
-                    addEventForSyncEstimate(workingSync);
-                    LOGC("UDP Events adding sync estimate with client soft secs: ", workingSync.syncSoftSecs, " local timestamp: ", workingSync.syncLocalTimestamp);
-                    String text = "UDP Events sync on line " + String(syncLine + 1) + "@" + String(workingSync.syncSoftSecs, 8, false) + "=" + String(workingSync.syncLocalSampleNumber);
-                    TextEventPtr textEvent = TextEvent::createTextEvent(getMessageChannel(),
-						workingSync.syncLocalTimestamp,
-                        text);
-                    addEvent(textEvent, 0);
-                    syncEstimates.push_back(workingSync);
-                    workingSync.clear();
-                }
-            }
+            // The working sync has seen both a real and a soft event.
+            completeSyncEstimate(route);
         }
     }
 }
@@ -25,7 +25,26 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <ProcessorHeaders.h>
 
-class UDPEventsPlugin : public GenericProcessor, public Thread
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "ClockModel.h"
+#include "PendingEvents.h"
+#include "ScheduledEvents.h"
+#include "SidecarFile.h"
+#include "SoftEvent.h"
+#include "SyncHistory.h"
+#include "UDPEventsLog.h"
+#include "UDPEventsProtocol.h"
+#include "OverflowPolicy.h"
+#include "UDPEventsLatency.h"
+#include "UDPEventsStats.h"
+
+class UDPEventsReceiver;
+
+class UDPEventsPlugin : public GenericProcessor
 {
 public:
 	/** The class constructor, used to initialize any members. */
@@ -42,20 +61,19 @@ public:
 	/** Called every time the settings of an upstream plugin are changed.
 		Allows the processor to handle variations in the channel configuration or any other parameter
 		passed through signal chain. The processor can use this function to modify channel objects that
-		will be passed to downstream plugins. */
+		will be passed to downstream plugins.
+		Here, look up each routed stream's TTL channel and sync settings, so process() doesn't search on every block. */
+	void updateSettings() override;
 
 	/** Update internal variables in respons selections made in the editor UI. */
 	void parameterValueChanged(Parameter *param) override;
 
-	/** Start the background UDP thread. */
+	/** Start the background UDP receiver threads. */
 	bool startAcquisition() override;
 
-	/** Stop the background UDP thread. */
+	/** Stop the background UDP receiver threads. */
 	bool stopAcquisition() override;
 
-	/** Check for UDP messages on a separate thread. */
-	void run() override;
-
 	/** Defines the functionality of the processor.
 		The process method is called every time a new data buffer is available.
 		Visualizer plugins typically use this method to send data to the canvas for display purposes */
@@ -66,127 +84,150 @@ public:
 		the plugin's process() method */
 	void handleTTLEvent(TTLEventPtr event) override;
 
+	/** Start writing a binary sidecar file in the recording directory, if enabled. */
+	void startRecording() override;
+
+	/** Finish the sidecar file. */
+	void stopRecording() override;
+
+	/** Live counters from the receiver threads and process(), for the editor to show. */
+	const UDPEventsStats &getStats() const { return stats; }
+
+	/** Latency histograms for each stage from receive to addEvent(), for the editor to show. */
+	const UDPEventsLatency &getLatency() const { return latency; }
+
 private:
 	/** Editable settings.*/
 	String hostToBind = "127.0.0.1";
+	String multicastGroup = "";
 	uint16 portToBind = 12345;
 	uint16 streamId = 0;
-	uint8 syncLine = 0;
-	uint8 syncStateIndex = 0;
-
-	/** Hold events received via UDP, until processing them into the selected data stream. */
-	struct SoftEvent
+	String streamsToRoute = "";
+	UDPEventsAckMode ackMode = ACK_PER_MESSAGE;
+	int syncWindow = 16;
+	int outlierThreshold = 5;
+	int syncHistoryCapacity = 1024;
+	int holdBackMillis = 5000;
+	int horizonMillis = 10000;
+	int receiverCount = 1;
+	bool writeSidecar = false;
+	int softEventQueueLimit = 4096;
+	int receiveBufferKilobytes = 0;
+	int busyPollMicros = 0;
+	int realtimePriority = 0;
+	String receiverCpus = "";
+	UDPEventsOverflowPolicy overflowPolicy = OVERFLOW_DROP_NEWEST;
+
+	/** Most receivers to run at once, so event sources fit in a SoftEvent and per-block bookkeeping fits on the stack. */
+	static const int maxReceiverCount = 16;
+
+	/** How many bytes of long message text can wait between each UDP thread and process(). */
+	static const int softEventTextCapacity = 1 << 20;
+
+	/** Sockets and threads receiving UDP messages, each with its own queue of events for process(). */
+	std::vector<std::unique_ptr<UDPEventsReceiver>> receivers;
+
+	/** Peek at the waiting event with the earliest client timestamp across all receivers, or get nullptr if none are waiting. */
+	SoftEvent *nextSoftEvent(UDPEventsReceiver *&fromReceiver);
+
+	/** Everything needed to add events to one data stream, with its own sync estimates and clock fit. */
+	struct StreamRoute
 	{
-		/** 0x01 = "TTL", 0x02 = "Text". */
-		uint8 type = 0;
+		uint16 streamId = 0;
+		float sampleRate = 0.0f;
+		EventChannel *ttlChannel = nullptr;
 
-		/** High-precision timestamp from the client's point of view. */
-		double clientSeconds = 0.0;
+		/** Which real and soft TTL events are sync events for this stream, from its LINE and STATE settings. */
+		SyncLineFilter syncFilter;
 
-		/** Acquisition message recv timestamp. */
-		int64 systemTimeMilliseconds = 0;
+		SyncEstimate workingSync;
 
-		/** 0-based line number for TTL events. */
-		uint8 lineNumber = 0;
+		/** Completed sync estimates, sorted and bounded, for converting events at any client time. */
+		SyncHistory syncEstimates;
 
-		/** On/off state for TTL events (nonzero means "on"). */
-		uint8 lineState = false;
+		/** Fit of client soft seconds to local sample numbers, over recent sync estimates. */
+		ClockModel clockModel;
 
-		/** Length in bytes for message text. */
-		uint16 textLength = 0;
+		/** Events that arrived before any sync estimate could convert them, waiting for one. */
+		PendingEvents pendingEvents;
 
-		/** Message text, treated as single-byte encoding UTF-8 or ASCII. */
-		String text = "";
+		/** TTL events whose sample numbers fall in later blocks, waiting for those blocks. */
+		ScheduledEvents scheduledEvents;
 	};
-	std::queue<SoftEvent> softEventQueue;
-	CriticalSection softEventQueueLock;
 
-	/** Pick the first TTL event channel on the selected stream, if any. */
-	EventChannel *pickTTLChannel();
+	/** Routes for the configured streams, or just the selected stream. */
+	std::vector<std::unique_ptr<StreamRoute>> streamRoutes;
 
-	/** Keep track of real and soft sync events and convert client soft secs to local sample numbers. */
-	struct SyncEstimate
-	{
-		/** Sample number of a real, local, sampled, sync event. */
-		int64 syncLocalSampleNumber = 0;
-
-		/** Timestamp of a real, local, sampled, sync event, I believe in ms. */
-		double syncLocalTimestamp = 0;
-
-		/** Timestamp of a corresponding soft, external sync event. */
-		double syncSoftSecs = 0.0;
-
-		/** Estimate of the local sample number that corresponds to soft timestamp 0.0.*/
-		int64 softSampleZero = 0;
-
-		/** Reset and begin a new estimate. */
-		void clear()
-		{
-			syncLocalSampleNumber = 0;
-			syncLocalTimestamp = 0;
-			syncSoftSecs = 0.0;
-			softSampleZero = 0;
-		}
-
-		/** Convert a soft, external timestamp to the nearest local sample number. */
-		int64 softSampleNumber(double softSecs, float localSampleRate)
-		{
-			int64 sampleNumber = softSecs * localSampleRate + softSampleZero;
-			LOGD("SyncEstimate computed sampleNumber ", (long)sampleNumber, " for softSecs ", softSecs, " at localSampleRate ", localSampleRate);
-			return sampleNumber;
-		}
-
-		/** Record the sample number of a real sync event, return whether the sync estimate is now complete. */
-		bool recordLocalSampleNumber(int64 sampleNumber, float localSampleRate)
-		{
-			syncLocalSampleNumber = sampleNumber;
-			LOGD("SyncEstimate got syncLocalSampleNumber ", (long)sampleNumber, " at localSampleRate ", localSampleRate);
-			if (syncSoftSecs)
-			{
-				softSampleZero = syncLocalSampleNumber - syncSoftSecs * localSampleRate;
-				LOGD("SyncEstimate computed softSampleZero ", (long)softSampleZero);
-				return true;
-			}
-			return false;
-		}
-
-		/** Record the timestamp of a real sync event, return whether the sync estimate is now complete. */
-		bool recordLocalTimestamp(int64 timeStamp, float localSampleRate)
-		{
-			syncLocalTimestamp = timeStamp;
-			LOGD("SyncEstimate got syncLocalTimestamp ", timeStamp, " at localSampleRate ", localSampleRate);
-			if (syncSoftSecs)
-			{
-				return true;
-			}
-			return false;
-		}
-
-		/** Record the timestamp of a soft sync event, return whether the sync estimate is now complete. */
-		bool recordSoftTimestamp(double softSecs, float localSampleRate)
-		{
-			syncSoftSecs = softSecs;
-			LOGD("SyncEstimate got syncSoftSecs ", syncSoftSecs, " at localSampleRate ", localSampleRate);
-			if (syncLocalSampleNumber)
-			{
-				softSampleZero = syncLocalSampleNumber - syncSoftSecs * localSampleRate;
-				LOGD("SyncEstimate computed softSampleZero ", (long)softSampleZero);
-				return true;
-			}
-			return false;
-		}
-	};
-	SyncEstimate workingSync;
-	std::list<SyncEstimate> syncEstimates;
+	/** The same routes, looked up by stream id. */
+	std::unordered_map<uint16, StreamRoute *> routesByStreamId;
+
+	/** Rebuild routes for the configured streams that exist and have TTL channels. */
+	void updateStreamRoutes();
+
+	/** Find the first TTL event channel on the given stream, if any. */
+	EventChannel *findTTLChannel(uint16 streamIdToFind);
+
+	/** Use a soft event as a sync event for the stream, or convert it and add it to the stream. */
+	void handleSoftEvent(StreamRoute &route, const SoftEvent &softEvent);
 
-	//** Check whether incoming event data matches TTL event selection in the UI. */
-	bool filterSyncEvent(uint8 line, bool state);
+	/** Feed the working sync estimate to the clock model, record it if accepted, and start a new one. */
+	void completeSyncEstimate(StreamRoute &route);
 
-	/** Add a text event to represent a completed sync estimate. */
-	void addEventForSyncEstimate(struct SyncEstimate syncEstimate);
+	/** Add a text event to represent a completed sync estimate and the clock fit, or an outlier the fit rejected. */
+	void addEventForSyncEstimate(const StreamRoute &route, const SyncEstimate &syncEstimate, bool accepted);
 
 	/** Convert a soft timestamp to the nearest local sample number using the most relevant sync estimate. */
-	int64 softSampleNumber(double softSecs, float localSampleRate);
+	int64 softSampleNumber(StreamRoute &route, double softSecs);
+
+	/** Add a soft TTL or Text event to the data stream at the given sample number, or schedule it for a later block. */
+	void addSoftEvent(StreamRoute &route, const SoftEvent &softEvent, int64 sampleNumber);
+
+	/** Add a soft TTL event at its sample offset within the current block, or at the start if its sample has passed.
+		The resolved time is when its sample number was known, for latency tracing. */
+	void addTTLEventAtSample(StreamRoute &route, const SoftEvent &softEvent, int64 sampleNumber, int64 resolvedNanos);
+
+	/** Record emit latency for an event just added to one stream. */
+	void recordEventAdded(int64 resolvedNanos);
+
+	/** Log percentiles for each latency stage, like at the end of acquisition. */
+	void logLatencyReport();
+
+	/** Hold back an event that no sync estimate can convert yet, or drop it if holding back is disabled or full. */
+	void holdBackSoftEvent(StreamRoute &route, const SoftEvent &softEvent);
+
+	/** Add held-back events that sync estimates now cover, and drop those that waited too long. */
+	void releasePendingEvents(StreamRoute &route);
+
+	/** Counted by receiver threads and process(), read by the editor and by stats requests. */
+	UDPEventsStats stats;
+
+	/** Recorded by receiver threads and process(), read by the editor and reported at the end of acquisition. */
+	UDPEventsLatency latency;
+
+	/** Binary record of sync pairs and event alignments while recording.
+		Opened by startRecording() and closed by stopRecording() on the message thread, and appended to only by process(). */
+	SidecarFile sidecar;
+
+	/** Set by startRecording() once the sidecar is open, and cleared to stop process() appending to it. */
+	std::atomic<bool> sidecarWanted{false};
+
+	/** Set by process() for the whole block, so closeSidecar() can wait until it's done with the sidecar. */
+	std::atomic<bool> sidecarInUse{false};
+
+	/** Whether process() is appending to the sidecar in this block, from sidecarWanted at the start of the block. */
+	bool sidecarActive = false;
+
+	/** Where the sidecar is, chosen by startRecording(). */
+	String sidecarPath;
+
+	/** Stop process() appending to the sidecar, wait for it to finish the current block, and close the file. */
+	void closeSidecar();
+
+	/** Record a soft event added to a stream, if the sidecar is open. */
+	void appendEventToSidecar(const StreamRoute &route, const SoftEvent &softEvent, int64 sampleNumber);
+
+	/** Append a record to the open sidecar, and count failures. */
+	void appendToSidecar(const SidecarRecord &record);
 };
 
 #endif
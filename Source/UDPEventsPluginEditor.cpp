@@ -26,7 +26,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 UDPEventsPluginEditor::UDPEventsPluginEditor(GenericProcessor *parentNode)
     : GenericEditor(parentNode)
 {
-    desiredWidth = 125;
+    desiredWidth = 230;
     addTextBoxParameterEditor(Parameter::PROCESSOR_SCOPE, "host", 5, 22);
     addTextBoxParameterEditor(Parameter::PROCESSOR_SCOPE, "port", 5, 44);
 
@@ -39,6 +39,44 @@ UDPEventsPluginEditor::UDPEventsPluginEditor(GenericProcessor *parentNode)
     streamSelection->setBounds(5, 110, 100, 20);
     streamSelection->addListener(this);
     addAndMakeVisible(streamSelection.get());
+
+    // Acks go in a second column, with buttons for everything else.
+    addComboBoxParameterEditor(Parameter::PROCESSOR_SCOPE, "ack", 120, 22);
+
+    settingsButton = std::make_unique<UtilityButton>("settings", Font("Fira Code", "Regular", 10.0f));
+    settingsButton->setBounds(120, 88, 100, 20);
+    settingsButton->setTooltip("Show clock fit, receive thread, and stream routing settings");
+    settingsButton->onClick = [this]
+    {
+        settingsPopup = showPopup(std::make_unique<UDPEventsSettingsPanel>(getProcessor()), settingsButton.get());
+    };
+    addAndMakeVisible(settingsButton.get());
+
+    statsButton = std::make_unique<UtilityButton>("stats", Font("Fira Code", "Regular", 10.0f));
+    statsButton->setBounds(120, 110, 100, 20);
+    statsButton->setTooltip("Show live stats and latency");
+    statsButton->onClick = [this]
+    {
+        UDPEventsPlugin *processor = (UDPEventsPlugin *)getProcessor();
+        auto statsDisplay = std::make_unique<UDPEventsStatsDisplay>(processor->getStats(), processor->getLatency());
+        statsDisplay->setSize(155, 110);
+        statsDisplay->timerCallback();
+        statsDisplay->startTimerHz(2);
+        statsPopup = showPopup(std::move(statsDisplay), statsButton.get());
+    };
+    addAndMakeVisible(statsButton.get());
+}
+
+UDPEventsPluginEditor::~UDPEventsPluginEditor()
+{
+    // Popups point at this editor and read the processor, so don't let them outlive it.
+    delete settingsPopup.getComponent();
+    delete statsPopup.getComponent();
+}
+
+CallOutBox *UDPEventsPluginEditor::showPopup(std::unique_ptr<Component> content, Button *anchor)
+{
+    return &CallOutBox::launchAsynchronously(std::move(content), anchor->getScreenBounds(), nullptr);
 }
 
 void UDPEventsPluginEditor::updateSettings()
@@ -85,12 +123,130 @@ void UDPEventsPluginEditor::comboBoxChanged(ComboBox *cb)
 
 void UDPEventsPluginEditor::startAcquisition()
 {
-    // Disable changing stream during acquisition.
+    // Disable changing stream and expert settings during acquisition.
     streamSelection->setEnabled(false);
+    settingsButton->setEnabled(false);
+    if (settingsPopup != nullptr)
+    {
+        settingsPopup->dismiss();
+    }
 }
 
 void UDPEventsPluginEditor::stopAcquisition()
 {
-    // Enable changing stream between acquisitions.
+    // Enable changing stream and expert settings between acquisitions.
     streamSelection->setEnabled(true);
+    settingsButton->setEnabled(true);
+}
+
+UDPEventsSettingsPanel::UDPEventsSettingsPanel(GenericProcessor *processor)
+{
+    // Clock fit options.
+    addParameterEditor(new TextBoxParameterEditor(processor->getParameter("window")), 5, 5);
+    addParameterEditor(new TextBoxParameterEditor(processor->getParameter("outlier")), 5, 27);
+    addParameterEditor(new TextBoxParameterEditor(processor->getParameter("history")), 5, 49);
+    addParameterEditor(new TextBoxParameterEditor(processor->getParameter("holdback")), 5, 71);
+    addParameterEditor(new TextBoxParameterEditor(processor->getParameter("horizon")), 5, 93);
+
+    // Queue and receive thread tuning.
+    addParameterEditor(new TextBoxParameterEditor(processor->getParameter("queue")), 120, 5);
+    addParameterEditor(new ComboBoxParameterEditor(processor->getParameter("overflow")), 120, 27);
+    addParameterEditor(new TextBoxParameterEditor(processor->getParameter("rcvbuf")), 120, 49);
+    addParameterEditor(new TextBoxParameterEditor(processor->getParameter("busypoll")), 120, 71);
+    addParameterEditor(new TextBoxParameterEditor(processor->getParameter("rtprio")), 120, 93);
+
+    // Stream routing and receiver placement.
+    addParameterEditor(new TextBoxParameterEditor(processor->getParameter("streams")), 235, 5);
+    addParameterEditor(new TextBoxParameterEditor(processor->getParameter("receivers")), 235, 27);
+    addParameterEditor(new TextBoxParameterEditor(processor->getParameter("group")), 235, 49);
+    addParameterEditor(new TextBoxParameterEditor(processor->getParameter("cpus")), 235, 71);
+    addParameterEditor(new ToggleParameterEditor(processor->getParameter("sidecar")), 235, 93);
+
+    setSize(345, 120);
+}
+
+void UDPEventsSettingsPanel::addParameterEditor(ParameterEditor *editor, int x, int y)
+{
+    parameterEditors.add(editor);
+    editor->setTopLeftPosition(x, y);
+    addAndMakeVisible(editor);
+}
+
+UDPEventsStatsDisplay::UDPEventsStatsDisplay(const UDPEventsStats &stats, const UDPEventsLatency &latency)
+    : Label("Stats Display"), stats(stats), latency(latency), previousMillis(Time::currentTimeMillis())
+{
+    stats.snapshot(previous);
+    setFont(Font("Fira Code", "Regular", 11.0f));
+    setJustificationType(Justification::topLeft);
+    setColour(Label::textColourId, Colours::black);
+    setText("no stats yet", dontSendNotification);
+    setTooltip("Click to switch between stats and latency");
+}
+
+void UDPEventsStatsDisplay::mouseUp(const MouseEvent &event)
+{
+    showingLatency = !showingLatency;
+    timerCallback();
+}
+
+void UDPEventsStatsDisplay::showLatency()
+{
+    // Microseconds up to 10 ms, then milliseconds, to keep columns narrow.
+    auto micros = [](uint64_t nanos)
+    {
+        return nanos < 10000000 ? String((int64)(nanos / 1000)) : String((int64)(nanos / 1000000)) + "m";
+    };
+
+    String text = "us     p50  p99  p99.9";
+    for (int i = 0; i < LATENCY_STAGE_COUNT; i++)
+    {
+        const UDPEventsLatencyStage stage = (UDPEventsLatencyStage)i;
+        const LatencyHistogram &histogram = latency.get(stage);
+        text << "\n" << String(UDPEventsLatency::name(stage)).paddedRight(' ', 7)
+             << micros(histogram.percentile(0.5)).paddedRight(' ', 5)
+             << micros(histogram.percentile(0.99)).paddedRight(' ', 5)
+             << micros(histogram.percentile(0.999));
+    }
+    setText(text, dontSendNotification);
+}
+
+void UDPEventsStatsDisplay::timerCallback()
+{
+    uint64_t current[STAT_COUNT];
+    stats.snapshot(current);
+    int64 nowMillis = Time::currentTimeMillis();
+    if (showingLatency)
+    {
+        showLatency();
+    }
+    else
+    {
+        showStats(current, nowMillis);
+    }
+    std::memcpy(previous, current, sizeof(previous));
+    previousMillis = nowMillis;
+}
+
+void UDPEventsStatsDisplay::showStats(const uint64_t current[STAT_COUNT], int64 nowMillis)
+{
+    double seconds = std::max(0.001, (nowMillis - previousMillis) / 1000.0);
+
+    // Counters restart at each acquisition, so don't let a restart look like a huge negative rate.
+    auto rate = [&](UDPEventsStat stat)
+    {
+        return current[stat] >= previous[stat] ? (current[stat] - previous[stat]) / seconds : 0.0;
+    };
+
+    uint64_t drops = current[STAT_QUEUE_OVERFLOWS] + current[STAT_QUEUE_DISCARDED_TTL] + current[STAT_QUEUE_DISCARDED_TEXT] + current[STAT_TEXT_STORAGE_FULL]
+                     + current[STAT_EVENTS_DROPPED_NO_SYNC] + current[STAT_EVENTS_DROPPED_NO_ROUTE]
+                     + current[STAT_EVENTS_DROPPED_PAST_HORIZON] + current[STAT_EVENTS_DROPPED_SCHEDULE_FULL]
+                     + current[STAT_EVENTS_EXPIRED];
+    String text;
+    text << "rx " << String(rate(STAT_MESSAGES_RECEIVED), 0) << "/s " << String(rate(STAT_BYTES_RECEIVED) / 1000.0, 1) << " kB/s\n";
+    text << "ttl " << String(rate(STAT_TTL_EVENTS_ADDED), 0) << "/s text " << String(rate(STAT_TEXT_EVENTS_ADDED), 0) << "/s\n";
+    text << "sync " << (int64)current[STAT_SYNC_PAIRS] << " out " << (int64)current[STAT_SYNC_OUTLIERS] << " est " << (int64)current[STAT_SYNC_ESTIMATES] << "\n";
+    text << "queue " << (int64)current[STAT_QUEUE_DEPTH] << " pending " << (int64)current[STAT_PENDING_EVENTS] << (current[STAT_BACKPRESSURE_ACKS] > previous[STAT_BACKPRESSURE_ACKS] ? " busy" : "") << "\n";
+    text << "late " << (int64)current[STAT_LATE_TTL_EVENTS] << " drops " << (int64)drops << "\n";
+    text << "errors " << (int64)(current[STAT_READ_ERRORS] + current[STAT_ACK_ERRORS] + current[STAT_UNKNOWN_MESSAGES]) << " kernel " << (int64)current[STAT_KERNEL_DROPS];
+    setText(text, dontSendNotification);
 }
@@ -25,6 +25,57 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <EditorHeaders.h>
 
+#include "UDPEventsLatency.h"
+#include "UDPEventsStats.h"
+
+/** Show a few lines of live stats, refreshed on a timer, with rates from one refresh to the next.
+	Click to switch between stats and latency percentiles for each stage.
+	The editor shows this in a popup from its stats button. */
+class UDPEventsStatsDisplay : public Label,
+							  public Timer
+{
+public:
+	UDPEventsStatsDisplay(const UDPEventsStats &stats, const UDPEventsLatency &latency);
+
+	/** Take a snapshot of the stats and show it. */
+	void timerCallback() override;
+
+	/** Switch between stats and latency. */
+	void mouseUp(const MouseEvent &event) override;
+
+private:
+	/** Show counts, and rates since the last refresh. */
+	void showStats(const uint64_t current[STAT_COUNT], int64 nowMillis);
+
+	/** Show p50, p99, and p99.9 latency for each stage. */
+	void showLatency();
+
+	const UDPEventsStats &stats;
+	const UDPEventsLatency &latency;
+	bool showingLatency = false;
+	uint64_t previous[STAT_COUNT];
+	int64 previousMillis;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(UDPEventsStatsDisplay);
+};
+
+/** Editors for the settings that most setups leave alone, in columns for the clock fit,
+	the receive threads, and stream routing.  The editor shows this in a popup from its settings button,
+	to keep the editor itself narrow. */
+class UDPEventsSettingsPanel : public Component
+{
+public:
+	UDPEventsSettingsPanel(GenericProcessor *processor);
+
+private:
+	/** Add an editor for one of the processor's parameters, at the given position. */
+	void addParameterEditor(ParameterEditor *editor, int x, int y);
+
+	OwnedArray<ParameterEditor> parameterEditors;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(UDPEventsSettingsPanel);
+};
+
 class UDPEventsPluginEditor : public GenericEditor,
 							  public ComboBox::Listener
 {
@@ -33,7 +84,7 @@ public:
 	UDPEventsPluginEditor(GenericProcessor *parentNode);
 
 	/** Destructor */
-	~UDPEventsPluginEditor() {}
+	~UDPEventsPluginEditor();
 
 	/** Called when underlying settings are updated */
 	void updateSettings() override;
@@ -51,6 +102,19 @@ private:
 	/** Dynamic combo box for selecting a stream by name.*/
 	std::unique_ptr<ComboBox> streamSelection;
 
+	/** Show a component in a popup pointing at the given button. */
+	CallOutBox *showPopup(std::unique_ptr<Component> content, Button *anchor);
+
+	/** Opens the expert settings, which can't change during acquisition. */
+	std::unique_ptr<UtilityButton> settingsButton;
+
+	/** Opens live stats and latency. */
+	std::unique_ptr<UtilityButton> statsButton;
+
+	/** Popups that are open, if any, cleared by JUCE when they close. */
+	Component::SafePointer<CallOutBox> settingsPopup;
+	Component::SafePointer<CallOutBox> statsPopup;
+
 	/** Generates an assertion if this class leaks */
 	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(UDPEventsPluginEditor);
 };
@@ -0,0 +1,116 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef UDPEVENTSPROTOCOL_H_DEFINED
+#define UDPEVENTSPROTOCOL_H_DEFINED
+
+/** Byte layouts for UDP Events messages and acks, shared by the plugin and any tools.  See also the README. */
+
+#include <cstdint>
+#include <cstring>
+
+/** Byte size of the header that starts TTL, text, and batch messages: type, client timestamp, and 2 type-specific bytes. */
+#define UDP_EVENTS_HEADER_LENGTH 11
+
+/** Message type for a batch of TTL and/or text records in one message.  The original types, TTL and text, are in SoftEvent.h. */
+#define UDP_EVENTS_MESSAGE_TYPE_BATCH 0x03
+
+/** Message type to ask for a snapshot of runtime stats, which comes back in a reply of the same type.  See UDPEventsStats.h. */
+#define UDP_EVENTS_MESSAGE_TYPE_STATS 0x04
+
+/** Flag bit a client can set in the message type byte, to ask for an ack in "on request" ack mode. */
+#define UDP_EVENTS_FLAG_ACK_REQUESTED 0x80
+
+/** Flag bit a client can set in the message type byte, to add the event to just one data stream, given by 2 bytes after the message. */
+#define UDP_EVENTS_FLAG_STREAM_TARGETED 0x40
+
+/** Mask to get the message type from the message type byte, without flag bits. */
+#define UDP_EVENTS_MESSAGE_TYPE_MASK 0x3F
+
+/** Byte size of the original, per-message ack: just the server timestamp. */
+#define UDP_EVENTS_ACK_LENGTH 8
+
+/** Byte size of the extended ack, which can acknowledge several messages at once. */
+#define UDP_EVENTS_EXTENDED_ACK_LENGTH 27
+
+/** Flag bit in the extended ack's flags byte, set when the receiver's queue is filling up, so clients can slow down or batch. */
+#define UDP_EVENTS_ACK_FLAG_BACKPRESSURE 0x01
+
+/** What to send back to clients as messages arrive. */
+enum UDPEventsAckMode
+{
+    /** One 8-byte ack for each message, the original behavior. */
+    ACK_PER_MESSAGE = 0,
+
+    /** No acks at all. */
+    ACK_NONE = 1,
+
+    /** One extended ack per client for each batch of received messages. */
+    ACK_COALESCED = 2,
+
+    /** One extended ack for each message with UDP_EVENTS_FLAG_ACK_REQUESTED set. */
+    ACK_ON_REQUEST = 3
+};
+
+/** Fields of an ack, before packing into bytes. */
+struct UDPEventsAck
+{
+    /** Server timestamp when the message was received, in milliseconds since the Unix epoch. */
+    int64_t serverMillis = 0;
+
+    /** Client timestamp from the last message acknowledged. */
+    double clientSeconds = 0.0;
+
+    /** How many messages this ack covers. */
+    uint16_t messageCount = 0;
+
+    /** Server receive time of the last message acknowledged, in nanoseconds since the Unix epoch. */
+    int64_t receiveNanos = 0;
+
+    /** Flag bits like UDP_EVENTS_ACK_FLAG_BACKPRESSURE, in extended acks only. */
+    uint8_t flags = 0;
+
+    /** Pack the original 8-byte ack into the given buffer, return the byte size. */
+    int packLegacy(char *buffer) const
+    {
+        std::memcpy(buffer, &serverMillis, 8);
+        return UDP_EVENTS_ACK_LENGTH;
+    }
+
+    /** Pack the extended ack into the given buffer, return the byte size. */
+    int packExtended(char *buffer) const
+    {
+        std::memcpy(buffer, &serverMillis, 8);
+        std::memcpy(buffer + 8, &clientSeconds, 8);
+
+        // Like text length in Text messages, this uses network byte order.
+        buffer[16] = (char)(messageCount >> 8);
+        buffer[17] = (char)(messageCount & 0xFF);
+
+        std::memcpy(buffer + 18, &receiveNanos, 8);
+        buffer[26] = (char)flags;
+        return UDP_EVENTS_EXTENDED_ACK_LENGTH;
+    }
+};
+
+#endif
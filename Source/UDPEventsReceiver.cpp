@@ -0,0 +1,260 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "UDPEventsReceiver.h"
+#include "UDPEventsLog.h"
+#include "UDPUtils.h"
+
+UDPEventsReceiver::UDPEventsReceiver(uint8 index, UDPEventsAckMode ackMode, int queueLimit, UDPEventsOverflowPolicy overflowPolicy, int textCapacity, UDPEventsStats &stats, UDPEventsLatency &latency)
+    : Thread("UDP Events Thread " + String(index)), index(index), softEventQueue(softEventQueueSlots(queueLimit, overflowPolicy)), softEventText(textCapacity), reader(index, ackMode, softEventQueue, softEventText, stats, latency)
+{
+    // Hold the receive thread to the limit, dropping by the policy as events arrive, and ask clients to back off once the queue is half way there.
+    configureSoftEventQueue(softEventQueue, queueLimit, overflowPolicy);
+    reader.setOverflowPolicy(overflowPolicy);
+    reader.setBackpressureDepth(queueLimit / 2);
+}
+
+UDPEventsReceiver::~UDPEventsReceiver()
+{
+    if (serverSocket >= 0)
+    {
+        udpCloseSocket(serverSocket);
+    }
+}
+
+bool UDPEventsReceiver::open(const String &host, uint16 port, bool reusePort, const String &group)
+{
+    // Create a new UDP socket to receive on.
+    serverSocket = udpOpenSocket();
+    if (serverSocket < 0)
+    {
+        LOGE("UDP Events Thread ", (int)index, " error creating socket: ", udpErrorMessage());
+        return false;
+    }
+
+    // Let other receivers share the address and port, if asked.
+    // Without this, the first receiver still works on its own and the others will fail to bind.
+    if (reusePort && udpEnableReusePort(serverSocket) < 0)
+    {
+        LOGE("UDP Events Thread ", (int)index, " can't share port: ", port, " with other receivers: ", udpErrorMessage());
+    }
+
+    // For a multicast group, the host chooses the interface to join on.
+    const bool multicast = group.isNotEmpty();
+    struct UdpAddress groupAddress;
+    struct UdpAddress interfaceAddress;
+    if (multicast)
+    {
+        groupAddress.port = port;
+        group.copyToUTF8(groupAddress.hostName, sizeof(groupAddress.hostName));
+        udpHostNameToBin(&groupAddress);
+        if (!udpIsMulticast(&groupAddress))
+        {
+            LOGE("UDP Events Thread ", (int)index, " can't join group: ", group, " because it's not a multicast address.");
+            udpCloseSocket(serverSocket);
+            serverSocket = -1;
+            return false;
+        }
+        interfaceAddress.port = 0;
+        host.copyToUTF8(interfaceAddress.hostName, sizeof(interfaceAddress.hostName));
+        udpHostNameToBin(&interfaceAddress);
+
+        // Let other UDP Events instances on this host bind the same port and get their own copy of each message.
+        if (udpEnableReuseAddress(serverSocket) < 0)
+        {
+            LOGE("UDP Events Thread ", (int)index, " can't share port: ", port, " with other instances: ", udpErrorMessage());
+        }
+    }
+
+    // Size the receive buffer for bursts, and optionally busy poll, before binding so the buffer applies from the first message.
+    if (receiveBufferBytes > 0 && udpSetReceiveBufferSize(serverSocket, receiveBufferBytes) < 0)
+    {
+        LOGE("UDP Events Thread ", (int)index, " could not set receive buffer to: ", receiveBufferBytes, " bytes: ", udpErrorMessage());
+    }
+    if (busyPollMicros > 0 && udpEnableBusyPoll(serverSocket, busyPollMicros) < 0)
+    {
+        LOGE("UDP Events Thread ", (int)index, " could not busy poll for: ", busyPollMicros, " us: ", udpErrorMessage());
+    }
+
+    // Bind the local address and port so we can receive, as a server.
+    // Multicast messages are addressed to the group, not the host, so bind any address for those.
+    struct UdpAddress addressToBind;
+    addressToBind.port = port;
+    (multicast ? String("0.0.0.0") : host).copyToUTF8(addressToBind.hostName, sizeof(addressToBind.hostName));
+    udpHostNameToBin(&addressToBind);
+    int bindResult = udpBind(serverSocket, &addressToBind);
+    if (bindResult < 0)
+    {
+        LOGE("UDP Events Thread ", (int)index, " could not bind socket to address: ", addressToBind.hostName, " port: ", port, " error: ", udpErrorMessage());
+        udpCloseSocket(serverSocket);
+        serverSocket = -1;
+        return false;
+    }
+
+    if (multicast && udpJoinMulticastGroup(serverSocket, &groupAddress, &interfaceAddress) < 0)
+    {
+        LOGE("UDP Events Thread ", (int)index, " could not join group: ", group, " on interface: ", host, " error: ", udpErrorMessage());
+        udpCloseSocket(serverSocket);
+        serverSocket = -1;
+        return false;
+    }
+
+    // Report the address and port we actually bound (they might have been assigned by system).
+    struct UdpAddress boundAddress;
+    udpGetAddress(serverSocket, &boundAddress);
+    udpHostBinToName(&boundAddress);
+    boundPort = boundAddress.port;
+    if (multicast)
+    {
+        LOGC("UDP Events Thread ", (int)index, " is ready to receive from group: ", group, " on interface: ", host, " port: ", boundAddress.port);
+    }
+    else
+    {
+        LOGC("UDP Events Thread ", (int)index, " is ready to receive at address: ", boundAddress.hostName, " port: ", boundAddress.port);
+    }
+
+    // The kernel might round or cap the buffer size we asked for, so say what we got.
+    LOGC("UDP Events Thread ", (int)index, " has a receive buffer of: ", udpGetReceiveBufferSize(serverSocket), " bytes");
+
+    // Prepare the reader here, before the thread starts, so signalStop() can always wake it.
+    if (!reader.prepare(serverSocket))
+    {
+        LOGC("UDP Events Thread ", (int)index, " will use its own receive timestamps since kernel timestamps are not available: ", udpErrorMessage());
+    }
+    if (reader.usesRing())
+    {
+        LOGC("UDP Events Thread ", (int)index, " will receive with io_uring.");
+    }
+    if (!reader.canWake())
+    {
+        LOGC("UDP Events Thread ", (int)index, " can't sleep until messages arrive, and will check for messages every 100 ms instead.");
+    }
+    return true;
+}
+
+void UDPEventsReceiver::signalStop()
+{
+    signalThreadShouldExit();
+    reader.wake();
+}
+
+void UDPEventsReceiver::applyThreadOptions()
+{
+    if (realtimePriority > 0)
+    {
+        if (threadSetRealtimePriority(realtimePriority) < 0)
+        {
+            LOGE("UDP Events Thread ", (int)index, " could not get real-time priority: ", realtimePriority, " and will keep default scheduling: ", threadErrorMessage());
+        }
+
+        // A page fault while reading or queueing would cost more than real-time priority saves, so keep our memory resident.
+        memoryLocked = lockMemory(true);
+        if (!memoryLocked)
+        {
+            LOGE("UDP Events Thread ", (int)index, " could not lock its buffers in memory: ", threadErrorMessage());
+            lockMemory(false);
+        }
+    }
+
+    if (cpuMask != 0 && threadSetAffinity(cpuMask) < 0)
+    {
+        LOGE("UDP Events Thread ", (int)index, " could not run on CPU mask: ", String::toHexString((int64)cpuMask), " and will run on any CPU: ", threadErrorMessage());
+    }
+
+    // Whatever we asked for, say what we got.
+    char scheduling[256];
+    threadDescribeScheduling(scheduling, sizeof(scheduling));
+    LOGC("UDP Events Thread ", (int)index, " is running with: ", scheduling);
+}
+
+bool UDPEventsReceiver::lockMemory(bool lock)
+{
+    struct Region
+    {
+        const void *address;
+        size_t bytes;
+    };
+    // Lock whichever receive buffers the reader uses now, and unlock the ones we locked.
+    if (lock)
+    {
+        lockedReceiveBuffers = reader.getReceiveBuffers(lockedReceiveBytes);
+    }
+    const Region regions[] = {
+        {lockedReceiveBuffers, lockedReceiveBytes},
+        {softEventQueue.data(), softEventQueue.capacity() * sizeof(SoftEvent)},
+        {softEventText.data(), softEventText.capacity()}};
+
+    bool allLocked = true;
+    for (const Region &region : regions)
+    {
+        const int result = lock ? threadLockMemory(region.address, region.bytes) : threadUnlockMemory(region.address, region.bytes);
+        allLocked = allLocked && result == 0;
+    }
+    return allLocked;
+}
+
+void UDPEventsReceiver::relockReceiveBuffers()
+{
+    size_t receiveBytes = 0;
+    const char *receiveBuffers = reader.getReceiveBuffers(receiveBytes);
+    if (receiveBuffers == lockedReceiveBuffers && receiveBytes == lockedReceiveBytes)
+    {
+        return;
+    }
+
+    // The old buffers went away with the ring, and their lock with them, so only the new ones need locking.
+    if (threadLockMemory(receiveBuffers, receiveBytes) < 0)
+    {
+        LOGE("UDP Events Thread ", (int)index, " could not lock its new receive buffers in memory: ", threadErrorMessage());
+    }
+    lockedReceiveBuffers = receiveBuffers;
+    lockedReceiveBytes = receiveBytes;
+}
+
+void UDPEventsReceiver::run()
+{
+    LOGC("UDP Events Thread ", (int)index, " is starting.");
+
+    applyThreadOptions();
+
+    // Read, parse, and ack messages, sleeping in between until more arrive or signalStop() wakes us.
+    while (!threadShouldExit())
+    {
+        reader.readBatch(-1);
+
+        // The reader can swap in new buffers if io_uring fails, which need locking too.
+        if (memoryLocked)
+        {
+            relockReceiveBuffers();
+        }
+    }
+
+    // The main loop has exited so we're done, so clean up and let the UDP thread terminate.
+    udpCloseSocket(serverSocket);
+    serverSocket = -1;
+    if (memoryLocked)
+    {
+        lockMemory(false);
+        memoryLocked = false;
+    }
+    LOGC("UDP Events Thread ", (int)index, " is stopping.");
+}
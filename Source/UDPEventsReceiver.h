@@ -0,0 +1,123 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef UDPEVENTSRECEIVER_H_DEFINED
+#define UDPEVENTSRECEIVER_H_DEFINED
+
+#include <ProcessorHeaders.h>
+
+#include "MessageReader.h"
+#include "OverflowPolicy.h"
+#include "SoftEvent.h"
+#include "SpscRing.h"
+#include "TextArena.h"
+#include "ThreadUtils.h"
+#include "UDPEventsProtocol.h"
+
+/**
+ * Receive UDP messages on one socket and thread, and hand parsed events to process() through a lock-free queue.
+ *
+ * Several receivers can share a host and port when the system supports SO_REUSEPORT.
+ * The kernel then picks a socket for each client, so each client's messages stay in order within one receiver's queue.
+ */
+class UDPEventsReceiver : public Thread
+{
+public:
+	/** Create a receiver with its own event queue and text storage, counting in shared stats and latency histograms.  The index is recorded in each event it receives.
+		The receiver thread holds the queue to the limit, dropping arriving or waiting events according to the overflow policy. */
+	UDPEventsReceiver(uint8 index, UDPEventsAckMode ackMode, int queueLimit, UDPEventsOverflowPolicy overflowPolicy, int textCapacity, UDPEventsStats &stats, UDPEventsLatency &latency);
+
+	/** Close the socket, if the thread never got to. */
+	~UDPEventsReceiver();
+
+	/** Choose a receive buffer size in bytes and busy poll time in microseconds for open() to apply, or 0 for system defaults. */
+	void setSocketOptions(int receiveBufferBytes, int busyPollMicros)
+	{
+		this->receiveBufferBytes = receiveBufferBytes;
+		this->busyPollMicros = busyPollMicros;
+	}
+
+	/** Choose a real-time priority (1-99) and CPU mask for run() to apply to the thread, or 0 for the defaults.
+		With real-time priority, run() also locks the reader's buffers, queue, and text storage in memory. */
+	void setThreadOptions(int realtimePriority, unsigned long long cpuMask)
+	{
+		this->realtimePriority = realtimePriority;
+		this->cpuMask = cpuMask;
+	}
+
+	/** Open and bind this receiver's socket, before starting its thread.  Return false, after logging why, if that didn't work.
+		With a multicast group, bind any address, join the group via the host interface, and share the port with other instances. */
+	bool open(const String &host, uint16 port, bool reusePort, const String &group);
+
+	/** The port the socket is bound to, which could have been assigned by the system. */
+	uint16 getBoundPort() const { return boundPort; }
+
+	/** Receive messages until asked to exit, then close the socket. */
+	void run() override;
+
+	/** Ask the thread to exit, and wake it if it's waiting for messages, so it stops right away. */
+	void signalStop();
+
+	/** Events waiting for process(), in the order they arrived at this receiver's socket. */
+	SpscRing<SoftEvent> &getQueue() { return softEventQueue; }
+
+	/** Storage for message text too long to fit inline in a SoftEvent from this receiver. */
+	TextArena &getTextArena() { return softEventText; }
+
+private:
+	const uint8 index;
+	int serverSocket = -1;
+	uint16 boundPort = 0;
+	int receiveBufferBytes = 0;
+	int busyPollMicros = 0;
+	int realtimePriority = 0;
+	unsigned long long cpuMask = 0;
+
+	/** Apply real-time priority, memory locking, and CPU affinity from the receiving thread, falling back to defaults and logging what we got. */
+	void applyThreadOptions();
+
+	/** Lock or unlock the memory this thread touches for each message.  Return false if any of it failed. */
+	bool lockMemory(bool lock);
+	bool memoryLocked = false;
+
+	/** Lock the reader's receive buffers if they changed since they were locked, like when it falls back from io_uring. */
+	void relockReceiveBuffers();
+
+	/** Receive buffers as of the last lock, so we unlock the same ones we locked. */
+	const char *lockedReceiveBuffers = nullptr;
+	size_t lockedReceiveBytes = 0;
+
+	/** Lock-free handoff of soft events from run() on this thread to process() on the main thread. */
+	SpscRing<SoftEvent> softEventQueue;
+
+	/** Message text too long to fit inline, released in bulk as process() drains the queue. */
+	TextArena softEventText;
+
+	/** Reads, parses, and acks messages into softEventQueue and softEventText. */
+	MessageReader reader;
+
+	/** Generates an assertion if this class leaks */
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(UDPEventsReceiver);
+};
+
+#endif
@@ -0,0 +1,250 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef UDPEVENTSSTATS_H_DEFINED
+#define UDPEVENTSSTATS_H_DEFINED
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "UDPEventsProtocol.h"
+
+/**
+ * Runtime counters and gauges, in the order they're sent in a stats reply.  See also the README.
+ *
+ * New stats go at the end, before STAT_COUNT, so existing ones keep their place in the reply.
+ */
+enum UDPEventsStat : uint16_t
+{
+    /** Messages read from sockets. */
+    STAT_MESSAGES_RECEIVED = 0,
+
+    /** Bytes in those messages. */
+    STAT_BYTES_RECEIVED,
+
+    /** Messages with an unknown type or too few bytes. */
+    STAT_UNKNOWN_MESSAGES,
+
+    /** Failed socket reads. */
+    STAT_READ_ERRORS,
+
+    /** Acks sent to clients. */
+    STAT_ACKS_SENT,
+
+    /** Acks that failed to send. */
+    STAT_ACK_ERRORS,
+
+    /** Events dropped because a receiver's queue was full. */
+    STAT_QUEUE_OVERFLOWS,
+
+    /** Text events dropped because a receiver's text storage was full. */
+    STAT_TEXT_STORAGE_FULL,
+
+    /** Stats requests answered. */
+    STAT_STATS_REQUESTS,
+
+    /** Soft TTL events added to data streams. */
+    STAT_TTL_EVENTS_ADDED,
+
+    /** Soft text events added. */
+    STAT_TEXT_EVENTS_ADDED,
+
+    /** Sync pairs accepted into clock fits. */
+    STAT_SYNC_PAIRS,
+
+    /** Sync pairs rejected as outliers. */
+    STAT_SYNC_OUTLIERS,
+
+    /** Events held back to wait for a sync estimate. */
+    STAT_EVENTS_HELD_BACK,
+
+    /** Events dropped with no sync estimate to convert them, because holding back is off or there was no room to hold them back. */
+    STAT_EVENTS_DROPPED_NO_SYNC,
+
+    /** Events dropped because they targeted a stream with no route. */
+    STAT_EVENTS_DROPPED_NO_ROUTE,
+
+    /** Soft TTL events added in a block after the one containing their sample number. */
+    STAT_LATE_TTL_EVENTS,
+
+    /** Gauge: events waiting in receiver queues, as of the last block. */
+    STAT_QUEUE_DEPTH,
+
+    /** Gauge: events held back or carried forward to later blocks, as of the last block. */
+    STAT_PENDING_EVENTS,
+
+    /** Gauge: sync estimates in all streams' histories, as of the last block. */
+    STAT_SYNC_ESTIMATES,
+
+    /** TTL events an overflow policy dropped while they waited in a queue. */
+    STAT_QUEUE_DISCARDED_TTL,
+
+    /** Text events an overflow policy dropped while they waited in a queue. */
+    STAT_QUEUE_DISCARDED_TEXT,
+
+    /** Acks sent with the backpressure flag set. */
+    STAT_BACKPRESSURE_ACKS,
+
+    /** Messages the kernel dropped before we could read them, for lack of socket buffer space, where the system reports it. */
+    STAT_KERNEL_DROPS,
+
+    /** TTL events dropped for aligning further ahead of the current block than the horizon setting. */
+    STAT_EVENTS_DROPPED_PAST_HORIZON,
+
+    /** TTL events dropped for lack of room to carry them forward to a later block. */
+    STAT_EVENTS_DROPPED_SCHEDULE_FULL,
+
+    /** Held-back events released to the data stream once a sync estimate covered them. */
+    STAT_EVENTS_RELEASED,
+
+    /** Held-back events dropped for waiting longer than the hold back setting for a sync estimate. */
+    STAT_EVENTS_EXPIRED,
+
+    /** Gauge: the most events seen waiting at once in any one receiver's queue since acquisition started, a high estimate. */
+    STAT_QUEUE_MAX_DEPTH,
+
+    STAT_COUNT
+};
+
+/** Byte size of a stats reply before the stats: type, version, stat count, client timestamp, and server timestamp. */
+#define UDP_EVENTS_STATS_REPLY_HEADER_LENGTH 20
+
+/** Version byte of the stats reply layout. */
+#define UDP_EVENTS_STATS_REPLY_VERSION 1
+
+/** Byte size of a stats reply with all the stats this version knows about. */
+#define UDP_EVENTS_STATS_REPLY_LENGTH (UDP_EVENTS_STATS_REPLY_HEADER_LENGTH + 8 * STAT_COUNT)
+
+/**
+ * Lock-free counters shared by receiver threads, process(), the editor, and stats requests.
+ *
+ * Updates are relaxed atomic adds, so counting never waits, and readers see each stat on its own, not a consistent set.
+ * Receivers add once per batch of messages rather than once per message, to keep shared cache lines quiet.
+ */
+class UDPEventsStats
+{
+public:
+    UDPEventsStats()
+    {
+        clear();
+    }
+
+    /** Zero all stats, like at the start of acquisition. */
+    void clear()
+    {
+        for (size_t i = 0; i < STAT_COUNT; i++)
+        {
+            values[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    /** Count some occurrences. */
+    void add(UDPEventsStat stat, uint64_t amount = 1)
+    {
+        values[stat].fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    /** Set a gauge. */
+    void set(UDPEventsStat stat, uint64_t value)
+    {
+        values[stat].store(value, std::memory_order_relaxed);
+    }
+
+    uint64_t get(UDPEventsStat stat) const
+    {
+        return values[stat].load(std::memory_order_relaxed);
+    }
+
+    /** Copy out all stats. */
+    void snapshot(uint64_t copy[STAT_COUNT]) const
+    {
+        for (size_t i = 0; i < STAT_COUNT; i++)
+        {
+            copy[i] = values[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    /** Pack a reply to a stats request into the given buffer of UDP_EVENTS_STATS_REPLY_LENGTH bytes, return the byte size. */
+    int packReply(char *buffer, double clientSeconds, int64_t serverMillis) const
+    {
+        buffer[0] = (char)UDP_EVENTS_MESSAGE_TYPE_STATS;
+        buffer[1] = (char)UDP_EVENTS_STATS_REPLY_VERSION;
+
+        // Like text length in Text messages, this uses network byte order.
+        buffer[2] = (char)(STAT_COUNT >> 8);
+        buffer[3] = (char)(STAT_COUNT & 0xFF);
+
+        // Like timestamps in acks, these use the host's byte order.
+        std::memcpy(buffer + 4, &clientSeconds, 8);
+        std::memcpy(buffer + 12, &serverMillis, 8);
+        for (size_t i = 0; i < STAT_COUNT; i++)
+        {
+            const uint64_t value = values[i].load(std::memory_order_relaxed);
+            std::memcpy(buffer + UDP_EVENTS_STATS_REPLY_HEADER_LENGTH + 8 * i, &value, 8);
+        }
+        return UDP_EVENTS_STATS_REPLY_LENGTH;
+    }
+
+    /** Short name for a stat, for display and tools. */
+    static const char *name(UDPEventsStat stat)
+    {
+        static const char *const names[STAT_COUNT] = {
+            "messages_received",
+            "bytes_received",
+            "unknown_messages",
+            "read_errors",
+            "acks_sent",
+            "ack_errors",
+            "queue_overflows",
+            "text_storage_full",
+            "stats_requests",
+            "ttl_events_added",
+            "text_events_added",
+            "sync_pairs",
+            "sync_outliers",
+            "events_held_back",
+            "events_dropped_no_sync",
+            "events_dropped_no_route",
+            "late_ttl_events",
+            "queue_depth",
+            "pending_events",
+            "sync_estimates",
+            "queue_discarded_ttl",
+            "queue_discarded_text",
+            "backpressure_acks",
+            "kernel_drops",
+            "events_dropped_past_horizon",
+            "events_dropped_schedule_full",
+            "events_released",
+            "events_expired",
+            "queue_max_depth"};
+        return stat < STAT_COUNT ? names[stat] : "unknown";
+    }
+
+private:
+    std::atomic<uint64_t> values[STAT_COUNT];
+};
+
+#endif
@@ -1,6 +1,8 @@
 #ifndef UDPUTILS_H_DEFINED
 #define UDPUTILS_H_DEFINED
 
+#include <stddef.h>
+
 /** Define several UDP socket operations to abstract us away from POSIX vs Winsock details. */
 
 /** Network IP v4 address and port that callers can allocate on the stack. */
@@ -16,6 +18,37 @@ struct UdpAddress
     unsigned short port;
 };
 
+/** Largest message we expect to receive, in bytes, the payload of a jumbo frame.  Longer messages are truncated to this and flagged. */
+#define UDP_MAX_MESSAGE_LENGTH 9000
+
+/** Most messages to read with one call to udpReceiveBatch(). */
+#define UDP_MAX_BATCH_SIZE 64
+
+/** One slot in a batch of received or sent messages.  Callers allocate the buffer, batch receive fills in the rest. */
+struct UdpMessage
+{
+    // Caller-allocated buffer to receive message bytes into, or to send bytes from.
+    char *buffer;
+
+    // Capacity of the buffer in bytes, or for sending, the number of bytes to send.
+    int bufferLength;
+
+    // Number of bytes actually read into the buffer.
+    int bytesRead;
+
+    // Whether the message was longer than the buffer, so the rest of it was discarded.
+    bool truncated;
+
+    // Kernel receive time in nanoseconds since the Unix epoch, or 0 if not available.
+    long long receiveNanos;
+
+    // Kernel count of messages dropped on this socket so far, for lack of buffer space, or 0 if not available.
+    unsigned int dropCount;
+
+    // Address of the client that sent the message.
+    struct UdpAddress address;
+};
+
 /** Create a socket with an integer handle.  Start (increment) the socket system as needed. */
 int udpOpenSocket();
 
@@ -43,9 +76,83 @@ bool udpAwaitMessage(int s, int timeoutMs);
 /** Read one message from an unconnected client.  Fill in the given address for the client and return the number of bytes read. */
 int udpReceiveFrom(int s, struct UdpAddress *const address, char *message, int messageLength);
 
+/** Let several sockets bind the same address and port, with the kernel spreading clients among them.  Call before udpBind().  Return negative if not supported. */
+int udpEnableReusePort(int s);
+
+/** Let several sockets, even in other processes, bind the same address and port, and each get a copy of multicast messages.  Call before udpBind().  Return negative on error. */
+int udpEnableReuseAddress(int s);
+
+/** Whether the address host is an IPv4 multicast group (224.0.0.0 - 239.255.255.255). */
+bool udpIsMulticast(const struct UdpAddress *const address);
+
+/** Join a multicast group, to receive messages sent to it, via the given local interface address (0.0.0.0 for any).  Return negative on error. */
+int udpJoinMulticastGroup(int s, const struct UdpAddress *const group, const struct UdpAddress *const localInterface);
+
+/** Choose the local interface address to send multicast messages from.  Return negative on error. */
+int udpSetMulticastInterface(int s, const struct UdpAddress *const localInterface);
+
+/** Choose how many router hops multicast messages can take (1 stays on the local network).  Return negative on error. */
+int udpSetMulticastTTL(int s, int ttl);
+
+/** Choose whether multicast messages also reach group members on the sending host.  Return negative on error. */
+int udpSetMulticastLoopback(int s, bool loopback);
+
+/** Ask the kernel to timestamp each received message, for udpReceiveBatch() to report.  Return negative if not supported. */
+int udpEnableReceiveTimestamps(int s);
+
+/** Ask for a receive buffer of the given size in bytes, so bursts can wait for us without being dropped.  Call before udpBind().  Return negative on error. */
+int udpSetReceiveBufferSize(int s, int bytes);
+
+/** Get the receive buffer size the kernel actually chose, which may differ from what was asked for, or negative on error. */
+int udpGetReceiveBufferSize(int s);
+
+/** Ask the kernel to busy poll the device queue for up to the given microseconds when reading, trading CPU for latency.  Return negative if not supported. */
+int udpEnableBusyPoll(int s, int micros);
+
+/** Ask the kernel to report how many messages it dropped on this socket, for udpReceiveBatch() to report.  Return negative if not supported. */
+int udpEnableDropCounts(int s);
+
+/** Get the current system time in nanoseconds since the Unix epoch, for when kernel timestamps are not available. */
+long long udpSystemTimeNanos();
+
+/** Read as many already-waiting messages as fit in the given slots (up to UDP_MAX_BATCH_SIZE), without blocking.  Return the number of messages read, or negative on error. */
+int udpReceiveBatch(int s, struct UdpMessage *messages, int messageCount);
+
+/** Receive state for the optional io_uring path, see udpOpenReceiveRing(). */
+struct UdpReceiveRing;
+
+/** Receive on a bound socket with io_uring, where messages land in a ring of pooled buffers the kernel picks from, to be read in place.
+    Each message needs one multishot recvmsg submission rather than a poll and a recvmmsg() per batch.
+    Return nullptr if not supported (only Linux builds with UDPEVENTS_IO_URING and kernel 5.19 or later are), so callers can keep using udpReceiveBatch(). */
+struct UdpReceiveRing *udpOpenReceiveRing(int s);
+
+/** Release the ring and its buffers.  Doesn't close the socket.  Safe to call with nullptr. */
+void udpCloseReceiveRing(struct UdpReceiveRing *ring);
+
+/** A handle that becomes readable when the ring has messages, to wait on with a UDPWaitSet instead of the socket. */
+int udpReceiveRingHandle(const struct UdpReceiveRing *ring);
+
+/** The ring's pooled buffers and their total size in bytes, for locking in memory. */
+const char *udpReceiveRingBuffers(const struct UdpReceiveRing *ring, size_t *bytes);
+
+/** Make sure the ring is receiving, before each wait, from the thread that reads the ring, so the kernel does receive work on that thread.
+    Receiving stops when all buffers are in use, so this resumes it after udpReleaseReceiveRing().  Return negative on error. */
+int udpArmReceiveRing(struct UdpReceiveRing *ring);
+
+/** Take as many received messages as fit in the given slots (up to UDP_MAX_BATCH_SIZE), without blocking.
+    Point each message's buffer at the ring buffer it landed in, which stays valid until udpReleaseReceiveRing().
+    Return the number of messages taken, or negative on error. */
+int udpReceiveRingBatch(struct UdpReceiveRing *ring, struct UdpMessage *messages, int messageCount);
+
+/** Give the buffers from the last udpReceiveRingBatch() back to the kernel, to receive into again. */
+void udpReleaseReceiveRing(struct UdpReceiveRing *ring);
+
 /** Send a message to the given unconnected client's address, return the number of bytes written. */
 int udpSendTo(int s, const struct UdpAddress *const address, const char *message, int messageLength);
 
+/** Send each message to its address, with as few system calls as possible.  Return the number of messages sent, or negative on error. */
+int udpSendBatch(int s, const struct UdpMessage *messages, int messageCount);
+
 /** Convert a 16-bit unsigned integer from netowrk to host byte order. */
 short unsigned int udpNToHS(short unsigned int netInt);
 
@@ -11,9 +11,17 @@
 #include <poll.h>
 #include <errno.h>
 #include <string.h>
+#include <time.h>
+#include <sys/time.h>
 
 #include "UDPUtils.h"
 
+#if defined(__linux__) && defined(UDPEVENTS_IO_URING)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
 int udpOpenSocket()
 {
     return socket(AF_INET, SOCK_DGRAM, 0);
@@ -81,6 +89,626 @@ int udpReceiveFrom(int s, struct UdpAddress *const address, char *message, int m
     return bytesRead;
 }
 
+int udpEnableReusePort(int s)
+{
+#ifdef SO_REUSEPORT
+    // Linux hashes each client's address and port to pick a socket, so each client's messages stay in order on one socket.
+    int enable = 1;
+    return setsockopt(s, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable));
+#else
+    errno = ENOPROTOOPT;
+    return -1;
+#endif
+}
+
+int udpEnableReuseAddress(int s)
+{
+    int enable = 1;
+    return setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+}
+
+bool udpIsMulticast(const struct UdpAddress *const address)
+{
+    return IN_MULTICAST(ntohl((uint32_t)address->host));
+}
+
+int udpJoinMulticastGroup(int s, const struct UdpAddress *const group, const struct UdpAddress *const localInterface)
+{
+    struct ip_mreq membership;
+    membership.imr_multiaddr.s_addr = (in_addr_t)group->host;
+    membership.imr_interface.s_addr = (in_addr_t)localInterface->host;
+    return setsockopt(s, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership));
+}
+
+int udpSetMulticastInterface(int s, const struct UdpAddress *const localInterface)
+{
+    struct in_addr interfaceAddress;
+    interfaceAddress.s_addr = (in_addr_t)localInterface->host;
+    return setsockopt(s, IPPROTO_IP, IP_MULTICAST_IF, &interfaceAddress, sizeof(interfaceAddress));
+}
+
+int udpSetMulticastTTL(int s, int ttl)
+{
+    unsigned char hops = (unsigned char)ttl;
+    return setsockopt(s, IPPROTO_IP, IP_MULTICAST_TTL, &hops, sizeof(hops));
+}
+
+int udpSetMulticastLoopback(int s, bool loopback)
+{
+    unsigned char enable = loopback ? 1 : 0;
+    return setsockopt(s, IPPROTO_IP, IP_MULTICAST_LOOP, &enable, sizeof(enable));
+}
+
+int udpEnableReceiveTimestamps(int s)
+{
+    int enable = 1;
+#ifdef SO_TIMESTAMPNS
+    return setsockopt(s, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable));
+#else
+    return setsockopt(s, SOL_SOCKET, SO_TIMESTAMP, &enable, sizeof(enable));
+#endif
+}
+
+int udpSetReceiveBufferSize(int s, int bytes)
+{
+#ifdef SO_RCVBUFFORCE
+    // Linux caps SO_RCVBUF at net.core.rmem_max, but lets privileged processes go past that.
+    if (setsockopt(s, SOL_SOCKET, SO_RCVBUFFORCE, &bytes, sizeof(bytes)) == 0)
+    {
+        return 0;
+    }
+#endif
+    return setsockopt(s, SOL_SOCKET, SO_RCVBUF, &bytes, sizeof(bytes));
+}
+
+int udpGetReceiveBufferSize(int s)
+{
+    int bytes = 0;
+    socklen_t length = sizeof(bytes);
+    if (getsockopt(s, SOL_SOCKET, SO_RCVBUF, &bytes, &length) < 0)
+    {
+        return -1;
+    }
+    return bytes;
+}
+
+int udpEnableBusyPoll(int s, int micros)
+{
+#ifdef SO_BUSY_POLL
+    return setsockopt(s, SOL_SOCKET, SO_BUSY_POLL, &micros, sizeof(micros));
+#else
+    return -1;
+#endif
+}
+
+int udpEnableDropCounts(int s)
+{
+#ifdef SO_RXQ_OVFL
+    int enable = 1;
+    return setsockopt(s, SOL_SOCKET, SO_RXQ_OVFL, &enable, sizeof(enable));
+#else
+    return -1;
+#endif
+}
+
+long long udpSystemTimeNanos()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+// Room for control messages that come along with each received message, like kernel timestamps and drop counts.
+#define UDP_CONTROL_BUFFER_LENGTH 128
+
+// Pick out kernel info from control messages that came along with a received message.
+static void readControlMessages(struct msghdr *header, struct UdpMessage *message)
+{
+    message->receiveNanos = 0;
+    message->dropCount = 0;
+    message->truncated = (header->msg_flags & MSG_TRUNC) != 0;
+    for (struct cmsghdr *control = CMSG_FIRSTHDR(header); control != NULL; control = CMSG_NXTHDR(header, control))
+    {
+        if (control->cmsg_level != SOL_SOCKET)
+        {
+            continue;
+        }
+#ifdef SCM_TIMESTAMPNS
+        if (control->cmsg_type == SCM_TIMESTAMPNS)
+        {
+            struct timespec receiveTime;
+            memcpy(&receiveTime, CMSG_DATA(control), sizeof(receiveTime));
+            message->receiveNanos = (long long)receiveTime.tv_sec * 1000000000LL + receiveTime.tv_nsec;
+        }
+#endif
+        if (control->cmsg_type == SCM_TIMESTAMP)
+        {
+            struct timeval receiveTime;
+            memcpy(&receiveTime, CMSG_DATA(control), sizeof(receiveTime));
+            message->receiveNanos = (long long)receiveTime.tv_sec * 1000000000LL + (long long)receiveTime.tv_usec * 1000LL;
+        }
+#ifdef SO_RXQ_OVFL
+        if (control->cmsg_type == SO_RXQ_OVFL)
+        {
+            memcpy(&message->dropCount, CMSG_DATA(control), sizeof(message->dropCount));
+        }
+#endif
+    }
+}
+
+#ifdef __linux__
+
+// Linux can read a whole batch of messages with one recvmmsg() syscall.
+
+int udpReceiveBatch(int s, struct UdpMessage *messages, int messageCount)
+{
+    if (messageCount > UDP_MAX_BATCH_SIZE)
+    {
+        messageCount = UDP_MAX_BATCH_SIZE;
+    }
+
+    struct mmsghdr headers[UDP_MAX_BATCH_SIZE];
+    struct iovec vectors[UDP_MAX_BATCH_SIZE];
+    struct sockaddr_in clientAddresses[UDP_MAX_BATCH_SIZE];
+    union
+    {
+        char buffer[UDP_CONTROL_BUFFER_LENGTH];
+        struct cmsghdr align;
+    } controls[UDP_MAX_BATCH_SIZE];
+    memset(headers, 0, messageCount * sizeof(struct mmsghdr));
+    for (int i = 0; i < messageCount; i++)
+    {
+        vectors[i].iov_base = messages[i].buffer;
+        vectors[i].iov_len = messages[i].bufferLength;
+        headers[i].msg_hdr.msg_iov = &vectors[i];
+        headers[i].msg_hdr.msg_iovlen = 1;
+        headers[i].msg_hdr.msg_name = &clientAddresses[i];
+        headers[i].msg_hdr.msg_namelen = sizeof(clientAddresses[i]);
+        headers[i].msg_hdr.msg_control = controls[i].buffer;
+        headers[i].msg_hdr.msg_controllen = sizeof(controls[i].buffer);
+    }
+
+    int messagesRead = recvmmsg(s, headers, messageCount, MSG_DONTWAIT, NULL);
+    if (messagesRead < 0)
+    {
+        // Nothing waiting is not an error for a non-blocking batch.
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : messagesRead;
+    }
+
+    for (int i = 0; i < messagesRead; i++)
+    {
+        messages[i].bytesRead = headers[i].msg_len;
+        messages[i].address.host = clientAddresses[i].sin_addr.s_addr;
+        messages[i].address.port = ntohs(clientAddresses[i].sin_port);
+        readControlMessages(&headers[i].msg_hdr, &messages[i]);
+    }
+    return messagesRead;
+}
+
+#else
+
+// Other POSIX systems like macOS lack recvmmsg(), so loop over non-blocking reads until the socket is drained.
+
+int udpReceiveBatch(int s, struct UdpMessage *messages, int messageCount)
+{
+    int messagesRead = 0;
+    while (messagesRead < messageCount)
+    {
+        struct UdpMessage *message = &messages[messagesRead];
+        struct sockaddr_in clientAddress;
+        struct iovec vector;
+        vector.iov_base = message->buffer;
+        vector.iov_len = message->bufferLength;
+        union
+        {
+            char buffer[UDP_CONTROL_BUFFER_LENGTH];
+            struct cmsghdr align;
+        } control;
+        struct msghdr header;
+        memset(&header, 0, sizeof(header));
+        header.msg_iov = &vector;
+        header.msg_iovlen = 1;
+        header.msg_name = &clientAddress;
+        header.msg_namelen = sizeof(clientAddress);
+        header.msg_control = control.buffer;
+        header.msg_controllen = sizeof(control.buffer);
+
+        int bytesRead = recvmsg(s, &header, MSG_DONTWAIT);
+        if (bytesRead < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                break;
+            }
+            return messagesRead > 0 ? messagesRead : bytesRead;
+        }
+        message->bytesRead = bytesRead;
+        message->address.host = clientAddress.sin_addr.s_addr;
+        message->address.port = ntohs(clientAddress.sin_port);
+        readControlMessages(&header, message);
+        messagesRead++;
+    }
+    return messagesRead;
+}
+
+#endif
+
+#if defined(__linux__) && defined(UDPEVENTS_IO_URING)
+
+// Linux 5.19 and later can receive with io_uring into a ring of provided buffers, using raw syscalls so we don't need liburing.
+
+// Pooled buffers to receive into, the same count and memory as a batch of regular receive buffers.
+#define UDP_RING_BUFFER_COUNT UDP_MAX_BATCH_SIZE
+
+// Each buffer holds the recvmsg header, client address, and control messages ahead of the message itself.
+#define UDP_RING_BUFFER_LENGTH (sizeof(struct io_uring_recvmsg_out) + sizeof(struct sockaddr_in) + UDP_CONTROL_BUFFER_LENGTH + UDP_MAX_MESSAGE_LENGTH)
+
+// Completions we can have waiting, with room for more than one per buffer in case of errors.
+#define UDP_RING_COMPLETION_COUNT (4 * UDP_RING_BUFFER_COUNT)
+
+// Tag for completions of the multishot recvmsg.
+#define UDP_RING_RECEIVE_TAG 1
+
+struct UdpReceiveRing
+{
+    int s;
+    int ringFd;
+
+    // Submission and completion queues share one mapping with the kernel, and submission entries have another.
+    void *queues;
+    size_t queuesBytes;
+    struct io_uring_sqe *submissions;
+    size_t submissionsBytes;
+    unsigned *submissionTail;
+    unsigned *submissionMask;
+    unsigned *submissionArray;
+    unsigned *completionHead;
+    unsigned *completionTail;
+    unsigned *completionMask;
+    struct io_uring_cqe *completions;
+
+    // Provided buffers, and the ring that tells the kernel which ones are free.
+    struct io_uring_buf_ring *bufferRing;
+    size_t bufferRingBytes;
+    char *buffers;
+    size_t buffersBytes;
+
+    // Buffers handed out by the last batch, to give back on release.
+    unsigned short takenBuffers[UDP_RING_COMPLETION_COUNT];
+    int takenCount;
+
+    // Tells multishot recvmsg how much room to leave for the client address and control messages.
+    struct msghdr receiveTemplate;
+    bool armed;
+};
+
+static int ioUringSetup(unsigned entries, struct io_uring_params *params)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int ioUringEnter(int ringFd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, NULL, 0);
+}
+
+static int ioUringRegister(int ringFd, unsigned opcode, void *arg, unsigned argCount)
+{
+    return (int)syscall(__NR_io_uring_register, ringFd, opcode, arg, argCount);
+}
+
+// Make a free buffer available to the kernel at the given position past the ring's current tail.
+static void offerRingBuffer(struct UdpReceiveRing *ring, unsigned short bufferId, unsigned short offset)
+{
+    // Entries start at the top of the ring, overlapping the tail.  We don't use the header's bufs member,
+    // because in C++ its flexible array comes after an empty struct, which takes up space and shifts the entries.
+    const unsigned short mask = UDP_RING_BUFFER_COUNT - 1;
+    struct io_uring_buf *entries = (struct io_uring_buf *)ring->bufferRing;
+    struct io_uring_buf *buffer = &entries[(ring->bufferRing->tail + offset) & mask];
+    buffer->addr = (unsigned long long)(ring->buffers + (size_t)bufferId * UDP_RING_BUFFER_LENGTH);
+    buffer->len = UDP_RING_BUFFER_LENGTH;
+    buffer->bid = bufferId;
+}
+
+struct UdpReceiveRing *udpOpenReceiveRing(int s)
+{
+    struct UdpReceiveRing *ring = new UdpReceiveRing();
+    memset(ring, 0, sizeof(*ring));
+    ring->s = s;
+    ring->queues = MAP_FAILED;
+    ring->submissions = (struct io_uring_sqe *)MAP_FAILED;
+    ring->bufferRing = (struct io_uring_buf_ring *)MAP_FAILED;
+    ring->buffers = (char *)MAP_FAILED;
+
+    // This fails where io_uring is missing, or disabled like by kernel.io_uring_disabled or a container's seccomp profile.
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = UDP_RING_COMPLETION_COUNT;
+    ring->ringFd = ioUringSetup(4, &params);
+    if (ring->ringFd < 0 || !(params.features & IORING_FEAT_SINGLE_MMAP))
+    {
+        udpCloseReceiveRing(ring);
+        return NULL;
+    }
+
+    // Check this kernel can do recvmsg at all, before we set up buffers.
+    unsigned long long probeStorage[(sizeof(struct io_uring_probe) + IORING_OP_LAST * sizeof(struct io_uring_probe_op)) / sizeof(unsigned long long) + 1];
+    memset(probeStorage, 0, sizeof(probeStorage));
+    struct io_uring_probe *probe = (struct io_uring_probe *)probeStorage;
+    if (ioUringRegister(ring->ringFd, IORING_REGISTER_PROBE, probe, IORING_OP_LAST) < 0
+        || probe->ops_len <= IORING_OP_RECVMSG
+        || !(probe->ops[IORING_OP_RECVMSG].flags & IO_URING_OP_SUPPORTED))
+    {
+        udpCloseReceiveRing(ring);
+        errno = EOPNOTSUPP;
+        return NULL;
+    }
+
+    ring->queuesBytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    const size_t completionBytes = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (completionBytes > ring->queuesBytes)
+    {
+        ring->queuesBytes = completionBytes;
+    }
+    ring->queues = mmap(NULL, ring->queuesBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ringFd, IORING_OFF_SQ_RING);
+    ring->submissionsBytes = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->submissions = (struct io_uring_sqe *)mmap(NULL, ring->submissionsBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ringFd, IORING_OFF_SQES);
+    if (ring->queues == MAP_FAILED || ring->submissions == MAP_FAILED)
+    {
+        udpCloseReceiveRing(ring);
+        return NULL;
+    }
+    char *queues = (char *)ring->queues;
+    ring->submissionTail = (unsigned *)(queues + params.sq_off.tail);
+    ring->submissionMask = (unsigned *)(queues + params.sq_off.ring_mask);
+    ring->submissionArray = (unsigned *)(queues + params.sq_off.array);
+    ring->completionHead = (unsigned *)(queues + params.cq_off.head);
+    ring->completionTail = (unsigned *)(queues + params.cq_off.tail);
+    ring->completionMask = (unsigned *)(queues + params.cq_off.ring_mask);
+    ring->completions = (struct io_uring_cqe *)(queues + params.cq_off.cqes);
+
+    // Registering a buffer ring needs Linux 5.19, so this is also our check for a new enough kernel.
+    ring->bufferRingBytes = UDP_RING_BUFFER_COUNT * sizeof(struct io_uring_buf);
+    ring->bufferRing = (struct io_uring_buf_ring *)mmap(NULL, ring->bufferRingBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ring->buffersBytes = UDP_RING_BUFFER_COUNT * UDP_RING_BUFFER_LENGTH;
+    ring->buffers = (char *)mmap(NULL, ring->buffersBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring->bufferRing == MAP_FAILED || ring->buffers == MAP_FAILED)
+    {
+        udpCloseReceiveRing(ring);
+        return NULL;
+    }
+    struct io_uring_buf_reg bufferRegistration;
+    memset(&bufferRegistration, 0, sizeof(bufferRegistration));
+    bufferRegistration.ring_addr = (unsigned long long)ring->bufferRing;
+    bufferRegistration.ring_entries = UDP_RING_BUFFER_COUNT;
+    bufferRegistration.bgid = 0;
+    if (ioUringRegister(ring->ringFd, IORING_REGISTER_PBUF_RING, &bufferRegistration, 1) < 0)
+    {
+        udpCloseReceiveRing(ring);
+        return NULL;
+    }
+    for (unsigned short i = 0; i < UDP_RING_BUFFER_COUNT; i++)
+    {
+        offerRingBuffer(ring, i, i);
+    }
+    __atomic_store_n(&ring->bufferRing->tail, (unsigned short)(ring->bufferRing->tail + UDP_RING_BUFFER_COUNT), __ATOMIC_RELEASE);
+
+    ring->receiveTemplate.msg_namelen = sizeof(struct sockaddr_in);
+    ring->receiveTemplate.msg_controllen = UDP_CONTROL_BUFFER_LENGTH;
+    return ring;
+}
+
+void udpCloseReceiveRing(struct UdpReceiveRing *ring)
+{
+    if (ring == NULL)
+    {
+        return;
+    }
+
+    // Closing the ring cancels the multishot recvmsg, and unregisters the buffers.
+    if (ring->ringFd >= 0)
+    {
+        close(ring->ringFd);
+    }
+    if (ring->queues != MAP_FAILED)
+    {
+        munmap(ring->queues, ring->queuesBytes);
+    }
+    if (ring->submissions != MAP_FAILED)
+    {
+        munmap(ring->submissions, ring->submissionsBytes);
+    }
+    if (ring->bufferRing != MAP_FAILED)
+    {
+        munmap(ring->bufferRing, ring->bufferRingBytes);
+    }
+    if (ring->buffers != MAP_FAILED)
+    {
+        munmap(ring->buffers, ring->buffersBytes);
+    }
+    delete ring;
+}
+
+int udpReceiveRingHandle(const struct UdpReceiveRing *ring)
+{
+    return ring->ringFd;
+}
+
+const char *udpReceiveRingBuffers(const struct UdpReceiveRing *ring, size_t *bytes)
+{
+    *bytes = ring->buffersBytes;
+    return ring->buffers;
+}
+
+int udpArmReceiveRing(struct UdpReceiveRing *ring)
+{
+    if (ring->armed)
+    {
+        return 0;
+    }
+
+    // One multishot recvmsg keeps receiving into free buffers, posting a completion per message, until it runs out of buffers.
+    const unsigned tail = *ring->submissionTail;
+    const unsigned index = tail & *ring->submissionMask;
+    struct io_uring_sqe *submission = &ring->submissions[index];
+    memset(submission, 0, sizeof(*submission));
+    submission->opcode = IORING_OP_RECVMSG;
+    submission->fd = ring->s;
+    submission->addr = (unsigned long long)&ring->receiveTemplate;
+    submission->len = 1;
+    submission->ioprio = IORING_RECV_MULTISHOT;
+    submission->flags = IOSQE_BUFFER_SELECT;
+    submission->buf_group = 0;
+    submission->user_data = UDP_RING_RECEIVE_TAG;
+    ring->submissionArray[index] = index;
+    __atomic_store_n(ring->submissionTail, tail + 1, __ATOMIC_RELEASE);
+
+    int submitted = ioUringEnter(ring->ringFd, 1, 0, 0);
+    if (submitted < 0)
+    {
+        return submitted;
+    }
+    ring->armed = true;
+    return 0;
+}
+
+int udpReceiveRingBatch(struct UdpReceiveRing *ring, struct UdpMessage *messages, int messageCount)
+{
+    if (messageCount > UDP_MAX_BATCH_SIZE)
+    {
+        messageCount = UDP_MAX_BATCH_SIZE;
+    }
+
+    int messagesRead = 0;
+    int error = 0;
+    unsigned head = *ring->completionHead;
+    const unsigned tail = __atomic_load_n(ring->completionTail, __ATOMIC_ACQUIRE);
+    while (head != tail && messagesRead < messageCount)
+    {
+        const struct io_uring_cqe *completion = &ring->completions[head & *ring->completionMask];
+        head++;
+
+        // Without this flag, the multishot recvmsg is done, like when it ran out of buffers, and needs to be armed again.
+        if (!(completion->flags & IORING_CQE_F_MORE))
+        {
+            ring->armed = false;
+        }
+        if (completion->flags & IORING_CQE_F_BUFFER)
+        {
+            ring->takenBuffers[ring->takenCount++] = (unsigned short)(completion->flags >> IORING_CQE_BUFFER_SHIFT);
+        }
+        if (completion->res < 0)
+        {
+            // Running out of buffers just leaves messages waiting in the socket until we arm again.
+            if (completion->res != -ENOBUFS)
+            {
+                error = -completion->res;
+            }
+            continue;
+        }
+        if (!(completion->flags & IORING_CQE_F_BUFFER))
+        {
+            continue;
+        }
+
+        // The buffer has a header, then room for the client address and control messages, then the message itself.
+        char *buffer = ring->buffers + (size_t)ring->takenBuffers[ring->takenCount - 1] * UDP_RING_BUFFER_LENGTH;
+        const struct io_uring_recvmsg_out *out = (const struct io_uring_recvmsg_out *)buffer;
+        const size_t prefixLength = sizeof(*out) + ring->receiveTemplate.msg_namelen + ring->receiveTemplate.msg_controllen;
+        if ((size_t)completion->res < prefixLength)
+        {
+            continue;
+        }
+
+        struct UdpMessage *message = &messages[messagesRead++];
+        struct sockaddr_in clientAddress;
+        memcpy(&clientAddress, buffer + sizeof(*out), sizeof(clientAddress));
+        message->address.host = clientAddress.sin_addr.s_addr;
+        message->address.port = ntohs(clientAddress.sin_port);
+        message->buffer = buffer + prefixLength;
+        message->bufferLength = (int)(completion->res - prefixLength);
+        message->bytesRead = message->bufferLength;
+
+        struct msghdr header;
+        memset(&header, 0, sizeof(header));
+        header.msg_control = buffer + sizeof(*out) + ring->receiveTemplate.msg_namelen;
+        header.msg_controllen = out->controllen;
+        header.msg_flags = out->flags;
+        readControlMessages(&header, message);
+    }
+    __atomic_store_n(ring->completionHead, head, __ATOMIC_RELEASE);
+
+    if (messagesRead == 0 && error != 0)
+    {
+        errno = error;
+        return -1;
+    }
+    return messagesRead;
+}
+
+void udpReleaseReceiveRing(struct UdpReceiveRing *ring)
+{
+    for (int i = 0; i < ring->takenCount; i++)
+    {
+        offerRingBuffer(ring, ring->takenBuffers[i], (unsigned short)i);
+    }
+    __atomic_store_n(&ring->bufferRing->tail, (unsigned short)(ring->bufferRing->tail + ring->takenCount), __ATOMIC_RELEASE);
+    ring->takenCount = 0;
+}
+
+#else
+
+// Elsewhere, callers keep using udpReceiveBatch().
+
+struct UdpReceiveRing *udpOpenReceiveRing(int s)
+{
+    (void)s;
+    errno = EOPNOTSUPP;
+    return NULL;
+}
+
+void udpCloseReceiveRing(struct UdpReceiveRing *ring)
+{
+    (void)ring;
+}
+
+int udpReceiveRingHandle(const struct UdpReceiveRing *ring)
+{
+    (void)ring;
+    return -1;
+}
+
+const char *udpReceiveRingBuffers(const struct UdpReceiveRing *ring, size_t *bytes)
+{
+    (void)ring;
+    *bytes = 0;
+    return NULL;
+}
+
+int udpArmReceiveRing(struct UdpReceiveRing *ring)
+{
+    (void)ring;
+    errno = EOPNOTSUPP;
+    return -1;
+}
+
+int udpReceiveRingBatch(struct UdpReceiveRing *ring, struct UdpMessage *messages, int messageCount)
+{
+    (void)ring;
+    (void)messages;
+    (void)messageCount;
+    errno = EOPNOTSUPP;
+    return -1;
+}
+
+void udpReleaseReceiveRing(struct UdpReceiveRing *ring)
+{
+    (void)ring;
+}
+
+#endif
+
 int udpSendTo(int s, const struct UdpAddress *const address, const char *message, int messageLength)
 {
     struct sockaddr_in clientAddress;
@@ -91,6 +719,68 @@ int udpSendTo(int s, const struct UdpAddress *const address, const char *message
     return sendto(s, message, messageLength, 0, (const struct sockaddr *)&clientAddress, clientAddressLength);
 }
 
+#ifdef __linux__
+
+// Linux can send a whole batch of messages with one sendmmsg() syscall.
+
+int udpSendBatch(int s, const struct UdpMessage *messages, int messageCount)
+{
+    if (messageCount > UDP_MAX_BATCH_SIZE)
+    {
+        messageCount = UDP_MAX_BATCH_SIZE;
+    }
+
+    struct mmsghdr headers[UDP_MAX_BATCH_SIZE];
+    struct iovec vectors[UDP_MAX_BATCH_SIZE];
+    struct sockaddr_in clientAddresses[UDP_MAX_BATCH_SIZE];
+    memset(headers, 0, messageCount * sizeof(struct mmsghdr));
+    for (int i = 0; i < messageCount; i++)
+    {
+        clientAddresses[i].sin_family = AF_INET;
+        clientAddresses[i].sin_addr.s_addr = messages[i].address.host;
+        clientAddresses[i].sin_port = htons(messages[i].address.port);
+        vectors[i].iov_base = messages[i].buffer;
+        vectors[i].iov_len = messages[i].bufferLength;
+        headers[i].msg_hdr.msg_iov = &vectors[i];
+        headers[i].msg_hdr.msg_iovlen = 1;
+        headers[i].msg_hdr.msg_name = &clientAddresses[i];
+        headers[i].msg_hdr.msg_namelen = sizeof(clientAddresses[i]);
+    }
+
+    // sendmmsg() can stop short, for example if the socket buffer fills up, so keep going with the rest.
+    int messagesSent = 0;
+    while (messagesSent < messageCount)
+    {
+        int result = sendmmsg(s, headers + messagesSent, messageCount - messagesSent, 0);
+        if (result <= 0)
+        {
+            return messagesSent > 0 ? messagesSent : result;
+        }
+        messagesSent += result;
+    }
+    return messagesSent;
+}
+
+#else
+
+int udpSendBatch(int s, const struct UdpMessage *messages, int messageCount)
+{
+    int messagesSent = 0;
+    while (messagesSent < messageCount)
+    {
+        const struct UdpMessage *message = &messages[messagesSent];
+        int bytesWritten = udpSendTo(s, &message->address, message->buffer, message->bufferLength);
+        if (bytesWritten < 0)
+        {
+            return messagesSent > 0 ? messagesSent : bytesWritten;
+        }
+        messagesSent++;
+    }
+    return messagesSent;
+}
+
+#endif
+
 short unsigned int udpNToHS(short unsigned int netInt)
 {
     return ntohs(netInt);
@@ -126,6 +126,161 @@ int udpReceiveFrom(int s, struct UdpAddress *const address, char *message, int m
     return bytesRead;
 }
 
+int udpEnableReusePort(int s)
+{
+    // Winsock SO_REUSEADDR lets sockets share a port, but doesn't spread messages among them.
+    return -1;
+}
+
+int udpEnableReuseAddress(int s)
+{
+    BOOL enable = TRUE;
+    return setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char *)&enable, sizeof(enable));
+}
+
+bool udpIsMulticast(const struct UdpAddress *const address)
+{
+    return IN_MULTICAST(ntohl((u_long)address->host));
+}
+
+int udpJoinMulticastGroup(int s, const struct UdpAddress *const group, const struct UdpAddress *const localInterface)
+{
+    struct ip_mreq membership;
+    membership.imr_multiaddr.s_addr = (u_long)group->host;
+    membership.imr_interface.s_addr = (u_long)localInterface->host;
+    return setsockopt(s, IPPROTO_IP, IP_ADD_MEMBERSHIP, (const char *)&membership, sizeof(membership));
+}
+
+int udpSetMulticastInterface(int s, const struct UdpAddress *const localInterface)
+{
+    struct in_addr interfaceAddress;
+    interfaceAddress.s_addr = (u_long)localInterface->host;
+    return setsockopt(s, IPPROTO_IP, IP_MULTICAST_IF, (const char *)&interfaceAddress, sizeof(interfaceAddress));
+}
+
+int udpSetMulticastTTL(int s, int ttl)
+{
+    DWORD hops = (DWORD)ttl;
+    return setsockopt(s, IPPROTO_IP, IP_MULTICAST_TTL, (const char *)&hops, sizeof(hops));
+}
+
+int udpSetMulticastLoopback(int s, bool loopback)
+{
+    DWORD enable = loopback ? 1 : 0;
+    return setsockopt(s, IPPROTO_IP, IP_MULTICAST_LOOP, (const char *)&enable, sizeof(enable));
+}
+
+int udpEnableReceiveTimestamps(int s)
+{
+    // Winsock doesn't offer kernel receive timestamps for UDP.
+    return -1;
+}
+
+int udpSetReceiveBufferSize(int s, int bytes)
+{
+    return setsockopt(s, SOL_SOCKET, SO_RCVBUF, (const char *)&bytes, sizeof(bytes));
+}
+
+int udpGetReceiveBufferSize(int s)
+{
+    int bytes = 0;
+    socklen_t length = sizeof(bytes);
+    if (getsockopt(s, SOL_SOCKET, SO_RCVBUF, (char *)&bytes, &length) != 0)
+    {
+        return -1;
+    }
+    return bytes;
+}
+
+int udpEnableBusyPoll(int s, int micros)
+{
+    // Winsock has no busy polling option for sockets.
+    return -1;
+}
+
+int udpEnableDropCounts(int s)
+{
+    // Winsock doesn't report receive buffer drops.
+    return -1;
+}
+
+long long udpSystemTimeNanos()
+{
+    // File time counts 100ns intervals since 1601, so shift to the Unix epoch.
+    FILETIME fileTime;
+    GetSystemTimePreciseAsFileTime(&fileTime);
+    ULARGE_INTEGER ticks;
+    ticks.LowPart = fileTime.dwLowDateTime;
+    ticks.HighPart = fileTime.dwHighDateTime;
+    return (long long)(ticks.QuadPart - 116444736000000000ULL) * 100LL;
+}
+
+int udpReceiveBatch(int s, struct UdpMessage *messages, int messageCount)
+{
+    // Winsock has no recvmmsg(), so loop over reads as long as more messages are waiting.
+    int messagesRead = 0;
+    while (messagesRead < messageCount && udpAwaitMessage(s, 0))
+    {
+        struct UdpMessage *message = &messages[messagesRead];
+        int bytesRead = udpReceiveFrom(s, &message->address, message->buffer, message->bufferLength);
+
+        // Winsock reports a message longer than the buffer as an error, after filling the buffer.
+        message->truncated = bytesRead < 0 && WSAGetLastError() == WSAEMSGSIZE;
+        if (message->truncated)
+        {
+            bytesRead = message->bufferLength;
+        }
+        if (bytesRead < 0)
+        {
+            return messagesRead > 0 ? messagesRead : bytesRead;
+        }
+        message->bytesRead = bytesRead;
+        message->receiveNanos = 0;
+        message->dropCount = 0;
+        messagesRead++;
+    }
+    return messagesRead;
+}
+
+// Windows has registered I/O rather than io_uring, so callers keep using udpReceiveBatch().
+
+struct UdpReceiveRing *udpOpenReceiveRing(int s)
+{
+    WSASetLastError(WSAEOPNOTSUPP);
+    return NULL;
+}
+
+void udpCloseReceiveRing(struct UdpReceiveRing *ring)
+{
+}
+
+int udpReceiveRingHandle(const struct UdpReceiveRing *ring)
+{
+    return -1;
+}
+
+const char *udpReceiveRingBuffers(const struct UdpReceiveRing *ring, size_t *bytes)
+{
+    *bytes = 0;
+    return NULL;
+}
+
+int udpArmReceiveRing(struct UdpReceiveRing *ring)
+{
+    WSASetLastError(WSAEOPNOTSUPP);
+    return -1;
+}
+
+int udpReceiveRingBatch(struct UdpReceiveRing *ring, struct UdpMessage *messages, int messageCount)
+{
+    WSASetLastError(WSAEOPNOTSUPP);
+    return -1;
+}
+
+void udpReleaseReceiveRing(struct UdpReceiveRing *ring)
+{
+}
+
 int udpSendTo(int s, const struct UdpAddress *const address, const char *message, int messageLength)
 {
     struct sockaddr_in clientAddress;
@@ -136,6 +291,23 @@ int udpSendTo(int s, const struct UdpAddress *const address, const char *message
     return sendto(s, message, messageLength, 0, (const struct sockaddr *)&clientAddress, clientAddressLength);
 }
 
+int udpSendBatch(int s, const struct UdpMessage *messages, int messageCount)
+{
+    // Winsock has no sendmmsg(), so loop over sends.
+    int messagesSent = 0;
+    while (messagesSent < messageCount)
+    {
+        const struct UdpMessage *message = &messages[messagesSent];
+        int bytesWritten = udpSendTo(s, &message->address, message->buffer, message->bufferLength);
+        if (bytesWritten < 0)
+        {
+            return messagesSent > 0 ? messagesSent : bytesWritten;
+        }
+        messagesSent++;
+    }
+    return messagesSent;
+}
+
 short unsigned int udpNToHS(short unsigned int netInt)
 {
     return ntohs(netInt);
@@ -0,0 +1,103 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef UDPWAITSET_H_DEFINED
+#define UDPWAITSET_H_DEFINED
+
+#include <cstdint>
+
+/** Most sockets one wait set can watch. */
+#define UDP_WAIT_SET_MAX_SOCKETS 16
+
+/** What ended a wait. */
+enum UDPWaitResult
+{
+    /** Something went wrong, see udpErrorMessage(). */
+    UDP_WAIT_ERROR = -1,
+
+    /** The timeout passed with nothing to do. */
+    UDP_WAIT_TIMEOUT = 0,
+
+    /** At least one socket has messages waiting to read. */
+    UDP_WAIT_READABLE = 1,
+
+    /** Another thread called wake(). */
+    UDP_WAIT_WOKEN = 2
+};
+
+/**
+ * Sleep until sockets have messages to read or another thread asks us to wake up, with POSIX vs Windows details in UDPWaitSet_POSIX.cpp and UDPWaitSet_WIN32.cpp.
+ *
+ * Linux uses epoll and an eventfd, other POSIX systems like macOS use poll() and a self-pipe, and Windows uses WSAEventSelect() and a WSA event.
+ * This lets a receiver thread sleep with no timeout, so it has no idle wakeups, and still stop right away.
+ * Open, add, and wait from one thread.  Any thread can wake() while the set is open,
+ * so only close() once no other thread can call wake(), like after joining it.
+ */
+class UDPWaitSet
+{
+public:
+    UDPWaitSet() = default;
+    ~UDPWaitSet();
+
+    UDPWaitSet(const UDPWaitSet &) = delete;
+    UDPWaitSet &operator=(const UDPWaitSet &) = delete;
+
+    /** Create the wait set and its wakeup signal, closing any previous one.  Return false on error. */
+    bool open();
+
+    /** Watch a socket for messages to read.  Return false on error or if the set is full.
+        On Windows, this makes the socket non-blocking. */
+    bool add(int s);
+
+    /** Sleep until a socket is readable, wake() was called, or the timeout passes, or forever if the timeout is negative.
+        Once woken, this keeps returning UDP_WAIT_WOKEN right away until the next open(). */
+    UDPWaitResult wait(int timeoutMillis);
+
+    /** Wake the waiting thread, now or the next time it waits. */
+    void wake();
+
+    /** Release the wait set and its signal.  Doesn't close the sockets.  Safe to call when not open.
+        Not safe while another thread might call wake(), which could write to a closed or reused handle. */
+    void close();
+
+    bool isOpen() const
+    {
+        return waitHandle != -1;
+    }
+
+private:
+    /** Platform handle to wait on: epoll on Linux, the self-pipe's read end on other POSIX systems, or the wakeup event on Windows. */
+    intptr_t waitHandle = -1;
+
+    /** Platform handle to wake with: eventfd on Linux, or the self-pipe's write end on other POSIX systems. */
+    intptr_t wakeHandle = -1;
+
+    int sockets[UDP_WAIT_SET_MAX_SOCKETS];
+
+    /** For Windows, one event per socket. */
+    intptr_t socketEvents[UDP_WAIT_SET_MAX_SOCKETS];
+
+    int socketCount = 0;
+};
+
+#endif
@@ -0,0 +1,218 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/** Implement UDPWaitSet for POSIX systems like Linux and macOS. */
+
+#ifndef WIN32
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "UDPWaitSet.h"
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
+UDPWaitSet::~UDPWaitSet()
+{
+    close();
+}
+
+void UDPWaitSet::close()
+{
+    if (wakeHandle != -1)
+    {
+        ::close((int)wakeHandle);
+        wakeHandle = -1;
+    }
+    if (waitHandle != -1)
+    {
+        ::close((int)waitHandle);
+        waitHandle = -1;
+    }
+    socketCount = 0;
+}
+
+#ifdef __linux__
+
+// Linux can wait on any number of sockets plus an eventfd with one epoll set, and doesn't rescan them on each wait.
+
+bool UDPWaitSet::open()
+{
+    close();
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0)
+    {
+        return false;
+    }
+    waitHandle = epollFd;
+
+    int eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (eventFd < 0)
+    {
+        close();
+        return false;
+    }
+    wakeHandle = eventFd;
+
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = eventFd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, eventFd, &event) < 0)
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool UDPWaitSet::add(int s)
+{
+    if (waitHandle == -1 || socketCount >= UDP_WAIT_SET_MAX_SOCKETS)
+    {
+        return false;
+    }
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = s;
+    if (epoll_ctl((int)waitHandle, EPOLL_CTL_ADD, s, &event) < 0)
+    {
+        return false;
+    }
+    sockets[socketCount++] = s;
+    return true;
+}
+
+UDPWaitResult UDPWaitSet::wait(int timeoutMillis)
+{
+    struct epoll_event events[UDP_WAIT_SET_MAX_SOCKETS + 1];
+    int ready = epoll_wait((int)waitHandle, events, UDP_WAIT_SET_MAX_SOCKETS + 1, timeoutMillis < 0 ? -1 : timeoutMillis);
+    if (ready < 0)
+    {
+        // A signal interrupting the wait is like a short timeout.
+        return errno == EINTR ? UDP_WAIT_TIMEOUT : UDP_WAIT_ERROR;
+    }
+
+    // Waking takes priority, so a busy socket can't hold off a stop.
+    bool readable = false;
+    for (int i = 0; i < ready; i++)
+    {
+        if (events[i].data.fd == (int)wakeHandle)
+        {
+            return UDP_WAIT_WOKEN;
+        }
+        readable = true;
+    }
+    return readable ? UDP_WAIT_READABLE : UDP_WAIT_TIMEOUT;
+}
+
+void UDPWaitSet::wake()
+{
+    // The eventfd counter is never read back, so it stays readable and every later wait returns right away.
+    uint64_t one = 1;
+    if (wakeHandle != -1)
+    {
+        ssize_t written = write((int)wakeHandle, &one, sizeof(one));
+        (void)written;
+    }
+}
+
+#else
+
+// Other POSIX systems like macOS lack epoll and eventfd, so poll() the sockets along with the read end of a pipe.
+
+bool UDPWaitSet::open()
+{
+    close();
+    int pipeFds[2];
+    if (pipe(pipeFds) < 0)
+    {
+        return false;
+    }
+    for (int i = 0; i < 2; i++)
+    {
+        fcntl(pipeFds[i], F_SETFL, fcntl(pipeFds[i], F_GETFL) | O_NONBLOCK);
+        fcntl(pipeFds[i], F_SETFD, FD_CLOEXEC);
+    }
+    waitHandle = pipeFds[0];
+    wakeHandle = pipeFds[1];
+    return true;
+}
+
+bool UDPWaitSet::add(int s)
+{
+    if (waitHandle == -1 || socketCount >= UDP_WAIT_SET_MAX_SOCKETS)
+    {
+        return false;
+    }
+    sockets[socketCount++] = s;
+    return true;
+}
+
+UDPWaitResult UDPWaitSet::wait(int timeoutMillis)
+{
+    struct pollfd pollFds[UDP_WAIT_SET_MAX_SOCKETS + 1];
+    pollFds[0].fd = (int)waitHandle;
+    pollFds[0].events = POLLIN;
+    pollFds[0].revents = 0;
+    for (int i = 0; i < socketCount; i++)
+    {
+        pollFds[i + 1].fd = sockets[i];
+        pollFds[i + 1].events = POLLIN;
+        pollFds[i + 1].revents = 0;
+    }
+
+    int ready = poll(pollFds, socketCount + 1, timeoutMillis < 0 ? -1 : timeoutMillis);
+    if (ready < 0)
+    {
+        // A signal interrupting the wait is like a short timeout.
+        return errno == EINTR ? UDP_WAIT_TIMEOUT : UDP_WAIT_ERROR;
+    }
+    if (ready == 0)
+    {
+        return UDP_WAIT_TIMEOUT;
+    }
+
+    // Waking takes priority, so a busy socket can't hold off a stop.
+    return (pollFds[0].revents & POLLIN) ? UDP_WAIT_WOKEN : UDP_WAIT_READABLE;
+}
+
+void UDPWaitSet::wake()
+{
+    // The pipe is never drained, so it stays readable and every later wait returns right away.
+    char one = 1;
+    if (wakeHandle != -1)
+    {
+        ssize_t written = write((int)wakeHandle, &one, sizeof(one));
+        (void)written;
+    }
+}
+
+#endif
+
+#endif
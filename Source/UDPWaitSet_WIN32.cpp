@@ -0,0 +1,128 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2022 Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/** Implement UDPWaitSet for Windows / Winsock systems. */
+
+#ifdef WIN32
+
+#include <winsock2.h>
+
+#include "UDPWaitSet.h"
+
+UDPWaitSet::~UDPWaitSet()
+{
+    close();
+}
+
+void UDPWaitSet::close()
+{
+    for (int i = 0; i < socketCount; i++)
+    {
+        // The socket might already be closed, and that's fine.
+        WSAEventSelect(sockets[i], NULL, 0);
+        WSACloseEvent((WSAEVENT)socketEvents[i]);
+    }
+    socketCount = 0;
+    if (waitHandle != -1)
+    {
+        WSACloseEvent((WSAEVENT)waitHandle);
+        waitHandle = -1;
+    }
+}
+
+bool UDPWaitSet::open()
+{
+    close();
+
+    // WSA events are manual reset, so once set, the wakeup event stays set.
+    WSAEVENT wakeEvent = WSACreateEvent();
+    if (wakeEvent == WSA_INVALID_EVENT)
+    {
+        return false;
+    }
+    waitHandle = (intptr_t)wakeEvent;
+    return true;
+}
+
+bool UDPWaitSet::add(int s)
+{
+    // Leave room for the wakeup event within Winsock's limit on events per wait.
+    if (waitHandle == -1 || socketCount >= UDP_WAIT_SET_MAX_SOCKETS || socketCount + 1 >= WSA_MAXIMUM_WAIT_EVENTS)
+    {
+        return false;
+    }
+    WSAEVENT socketEvent = WSACreateEvent();
+    if (socketEvent == WSA_INVALID_EVENT)
+    {
+        return false;
+    }
+    if (WSAEventSelect(s, socketEvent, FD_READ) != 0)
+    {
+        WSACloseEvent(socketEvent);
+        return false;
+    }
+    sockets[socketCount] = s;
+    socketEvents[socketCount] = (intptr_t)socketEvent;
+    socketCount++;
+    return true;
+}
+
+UDPWaitResult UDPWaitSet::wait(int timeoutMillis)
+{
+    WSAEVENT events[UDP_WAIT_SET_MAX_SOCKETS + 1];
+    events[0] = (WSAEVENT)waitHandle;
+    for (int i = 0; i < socketCount; i++)
+    {
+        events[i + 1] = (WSAEVENT)socketEvents[i];
+    }
+
+    // This reports the lowest signaled event, so waking takes priority over a busy socket.
+    DWORD result = WSAWaitForMultipleEvents(socketCount + 1, events, FALSE, timeoutMillis < 0 ? WSA_INFINITE : (DWORD)timeoutMillis, FALSE);
+    if (result == WSA_WAIT_TIMEOUT)
+    {
+        return UDP_WAIT_TIMEOUT;
+    }
+    if (result == WSA_WAIT_FAILED)
+    {
+        return UDP_WAIT_ERROR;
+    }
+    DWORD index = result - WSA_WAIT_EVENT_0;
+    if (index == 0)
+    {
+        return UDP_WAIT_WOKEN;
+    }
+
+    // Winsock signals FD_READ again after the next read if messages are still waiting, so it's safe to reset before reading.
+    WSAResetEvent(events[index]);
+    return UDP_WAIT_READABLE;
+}
+
+void UDPWaitSet::wake()
+{
+    if (waitHandle != -1)
+    {
+        WSASetEvent((WSAEVENT)waitHandle);
+    }
+}
+
+#endif
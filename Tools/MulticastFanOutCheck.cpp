@@ -0,0 +1,107 @@
+/** Check that one multicast message reaches several receivers at once, like several UDP Events instances on one host.
+ *
+ * Each receiver opens its own socket the way UDP Events does for a multicast GROUP: share the port, bind any address, and join the group.
+ * One sender then sends each message once to the group, over the loopback interface, so nothing leaves this host.
+ * Exit status is 0 if every receiver got every message.
+ *
+ * Usage: MulticastFanOutCheck [receiverCount] [messageCount] [group] [port]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "UDPUtils.h"
+
+/** Fill in an address from a dotted host name and port. */
+static UdpAddress makeAddress(const char *hostName, unsigned short port)
+{
+    UdpAddress address;
+    std::memset(&address, 0, sizeof(address));
+    std::strncpy(address.hostName, hostName, sizeof(address.hostName) - 1);
+    address.port = port;
+    udpHostNameToBin(&address);
+    return address;
+}
+
+int main(int argc, char **argv)
+{
+    const int receiverCount = argc > 1 ? std::atoi(argv[1]) : 4;
+    const int messageCount = argc > 2 ? std::atoi(argv[2]) : 100;
+    const char *groupName = argc > 3 ? argv[3] : "239.255.42.99";
+    const unsigned short port = (unsigned short)(argc > 4 ? std::atoi(argv[4]) : 12346);
+    UdpAddress group = makeAddress(groupName, port);
+    if (receiverCount <= 0 || messageCount <= 0 || !udpIsMulticast(&group))
+    {
+        std::printf("Usage: %s [receiverCount] [messageCount] [group] [port]\n", argv[0]);
+        return 1;
+    }
+
+    const UdpAddress loopback = makeAddress("127.0.0.1", 0);
+    const UdpAddress anyAddress = makeAddress("0.0.0.0", port);
+
+    // Open receivers like UDP Events with a multicast group, all joined via the loopback interface.
+    std::vector<int> receivers;
+    for (int i = 0; i < receiverCount; i++)
+    {
+        int s = udpOpenSocket();
+        if (s < 0 || udpEnableReuseAddress(s) < 0 || udpBind(s, &anyAddress) < 0 || udpJoinMulticastGroup(s, &group, &loopback) < 0)
+        {
+            std::printf("Receiver %d could not join group %s port %u: %s\n", i, groupName, (unsigned)port, udpErrorMessage());
+            return 1;
+        }
+        receivers.push_back(s);
+    }
+
+    // Send each message once, to the group, keeping it on this host.
+    int sender = udpOpenSocket();
+    if (sender < 0 || udpSetMulticastInterface(sender, &loopback) < 0 || udpSetMulticastLoopback(sender, true) < 0 || udpSetMulticastTTL(sender, 0) < 0)
+    {
+        std::printf("Sender could not set up multicast: %s\n", udpErrorMessage());
+        return 1;
+    }
+    for (int i = 0; i < messageCount; i++)
+    {
+        // A TTL message with the message index as its client timestamp.
+        char message[11] = {0x01};
+        const double clientSeconds = (double)i;
+        std::memcpy(message + 1, &clientSeconds, sizeof(clientSeconds));
+        if (udpSendTo(sender, &group, message, sizeof(message)) != sizeof(message))
+        {
+            std::printf("Sender could not send message %d: %s\n", i, udpErrorMessage());
+            return 1;
+        }
+    }
+
+    // Each receiver should have its own copy of every message.
+    std::vector<char> buffers(UDP_MAX_BATCH_SIZE * 64);
+    UdpMessage batch[UDP_MAX_BATCH_SIZE];
+    for (int i = 0; i < UDP_MAX_BATCH_SIZE; i++)
+    {
+        batch[i].buffer = buffers.data() + i * 64;
+        batch[i].bufferLength = 64;
+    }
+
+    bool allReceived = true;
+    for (int i = 0; i < receiverCount; i++)
+    {
+        int received = 0;
+        while (received < messageCount && udpAwaitMessage(receivers[i], 1000))
+        {
+            int batchCount = udpReceiveBatch(receivers[i], batch, UDP_MAX_BATCH_SIZE);
+            if (batchCount < 0)
+            {
+                break;
+            }
+            received += batchCount;
+        }
+        std::printf("receiver %d got %d of %d messages\n", i, received, messageCount);
+        allReceived = allReceived && received == messageCount;
+        udpCloseSocket(receivers[i]);
+    }
+    udpCloseSocket(sender);
+
+    std::printf(allReceived ? "fan-out OK\n" : "fan-out FAILED\n");
+    return allReceived ? 0 : 1;
+}
@@ -0,0 +1,587 @@
+/** Realign recorded UDP Events text events offline, using every sync pair in the recording instead of only earlier ones.
+ *
+ * The input is the text.npy that Open Ephys binary format records text events in, like events/MessageCenter/text.npy,
+ * or a text file with one event text per line.  Either way the output has one event text per line, in input order,
+ * so line i still goes with entry i of the recording's sample_numbers.npy and timestamps.npy.
+ * Lines containing "UDP Events sync on line N@secs=sample" are sync pairs, with an optional "#streamId" and clock fit details after,
+ * and pass through unchanged.
+ * Lines ending with "@secs=sample" or "@secs=sample#streamId" are soft events, and get their sample number rewritten.
+ * Other lines pass through unchanged.
+ *
+ * The first pass collects sync pairs and the second pass rewrites events.  Each pass reads the file in rounds of
+ * line-aligned chunks, or strings from the .npy, that worker threads parse in parallel, so memory stays bounded for long recordings.
+ * Between passes, each stream's pairs go through ClockModel to drop outliers like UDP Events does online.
+ * Then a ClockModel window centered on each accepted pair gives a smoothed sample number there,
+ * and events are interpolated between the pairs on either side.
+ *
+ * Usage: RealignEvents inputFile outputFile [window] [threadCount] [chunkMegabytes]
+ */
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "ClockModel.h"
+
+/** Literal text at the start of every sync pair text event. */
+static const std::string_view SYNC_PREFIX = "UDP Events sync on ";
+
+/** Stream key for sync pairs and events that don't say which stream, because UDP Events routed to just one. */
+static const int UNKNOWN_STREAM = -1;
+
+/** Same outlier threshold as the plugin's default OUTLIER setting. */
+static const double OUTLIER_THRESHOLD = 5.0;
+
+struct SyncPair
+{
+    double softSecs;
+    int64_t sampleNumber;
+};
+
+/** The "@secs=sample#stream" timing suffix at the end of a line. */
+struct TimingSuffix
+{
+    double softSecs = 0.0;
+    int64_t sampleNumber = 0;
+    int streamId = UNKNOWN_STREAM;
+
+    /** Where the sample number starts and ends in the line, for rewriting. */
+    size_t sampleBegin = 0;
+    size_t sampleEnd = 0;
+};
+
+/** Parse the timing suffix at the end of a line, return false if there isn't one. */
+static bool parseTimingSuffix(std::string_view line, TimingSuffix &suffix)
+{
+    while (!line.empty() && (line.back() == '\r' || line.back() == '\n'))
+    {
+        line.remove_suffix(1);
+    }
+    const size_t at = line.rfind('@');
+    if (at == std::string_view::npos)
+    {
+        return false;
+    }
+
+    const char *end = line.data() + line.size();
+    auto secs = std::from_chars(line.data() + at + 1, end, suffix.softSecs);
+    if (secs.ec != std::errc() || secs.ptr == end || *secs.ptr != '=')
+    {
+        return false;
+    }
+    const char *sampleBegin = secs.ptr + 1;
+    auto sample = std::from_chars(sampleBegin, end, suffix.sampleNumber);
+    if (sample.ec != std::errc())
+    {
+        return false;
+    }
+    suffix.sampleBegin = sampleBegin - line.data();
+    suffix.sampleEnd = sample.ptr - line.data();
+
+    suffix.streamId = UNKNOWN_STREAM;
+    if (sample.ptr == end)
+    {
+        return true;
+    }
+    if (*sample.ptr != '#')
+    {
+        return false;
+    }
+    auto stream = std::from_chars(sample.ptr + 1, end, suffix.streamId);
+    return stream.ec == std::errc() && stream.ptr == end;
+}
+
+/** Parse a sync pair line, return false if it's not one or if UDP Events rejected it as an outlier. */
+static bool parseSyncPair(std::string_view line, int &streamId, SyncPair &pair)
+{
+    const size_t prefix = line.find(SYNC_PREFIX);
+    if (prefix == std::string_view::npos)
+    {
+        return false;
+    }
+
+    // Clock fit details follow the timing suffix after a space, so set them aside before parsing it.
+    const size_t at = line.rfind('@');
+    if (at == std::string_view::npos || at < prefix)
+    {
+        return false;
+    }
+    const size_t space = line.find(' ', at);
+    if (space != std::string_view::npos)
+    {
+        if (line.substr(space, 8) == " outlier")
+        {
+            return false;
+        }
+        line = line.substr(0, space);
+    }
+    TimingSuffix suffix;
+    if (!parseTimingSuffix(line, suffix))
+    {
+        return false;
+    }
+    streamId = suffix.streamId;
+    pair = {suffix.softSecs, suffix.sampleNumber};
+    return true;
+}
+
+/** Call visit() for each line in a chunk of text, including its line break. */
+template <typename Visitor>
+static void forEachLine(std::string_view chunk, Visitor visit)
+{
+    while (!chunk.empty())
+    {
+        const size_t newline = chunk.find('\n');
+        const size_t length = newline == std::string_view::npos ? chunk.size() : newline + 1;
+        visit(chunk.substr(0, length));
+        chunk.remove_prefix(length);
+    }
+}
+
+/** Layout of a NumPy .npy array of fixed-width strings, like the text.npy that Open Ephys binary format records text events in. */
+struct NpyStrings
+{
+    /** Bytes per string, and whether they're UTF-32 ('<U') rather than bytes ('|S'). */
+    size_t itemBytes = 0;
+    bool utf32 = false;
+    size_t count = 0;
+};
+
+/** Check for .npy magic at the start of a file, and if it's there, parse the header and leave the file at the first string.
+    Return false for other files, with the file back at the start, or set error for .npy files we can't read. */
+static bool readNpyHeader(FILE *file, NpyStrings &layout, bool &error)
+{
+    error = false;
+    unsigned char preamble[12];
+    const size_t got = std::fread(preamble, 1, sizeof(preamble), file);
+    if (got < 10 || std::memcmp(preamble, "\x93NUMPY", 6) != 0)
+    {
+        std::rewind(file);
+        return false;
+    }
+
+    // Version 1 has a 2-byte header length, later versions 4 bytes, all little-endian.
+    const bool shortLength = preamble[6] == 1;
+    const size_t preambleBytes = shortLength ? 10 : 12;
+    const size_t headerBytes = shortLength ? (size_t)(preamble[8] | preamble[9] << 8)
+                                           : (size_t)(preamble[8] | preamble[9] << 8 | preamble[10] << 16 | (size_t)preamble[11] << 24);
+    std::string header(headerBytes, '\0');
+    if (std::fseek(file, (long)preambleBytes, SEEK_SET) != 0 || std::fread(&header[0], 1, headerBytes, file) != headerBytes)
+    {
+        error = true;
+        return true;
+    }
+
+    // The header is a Python dict literal, like {'descr': '|S200', 'fortran_order': False, 'shape': (1234,), }
+    const size_t descr = header.find("'descr'");
+    const size_t type = descr == std::string::npos ? std::string::npos : header.find('\'', header.find(':', descr));
+    const size_t shape = header.find("'shape'");
+    const size_t open = shape == std::string::npos ? std::string::npos : header.find('(', shape);
+    if (type == std::string::npos || open == std::string::npos || type + 3 >= header.size())
+    {
+        error = true;
+        return true;
+    }
+    const char order = header[type + 1];
+    const char kind = header[type + 2];
+    const char *sizeBegin = header.data() + type + 3;
+    auto size = std::from_chars(sizeBegin, header.data() + header.size(), layout.itemBytes);
+    auto count = std::from_chars(header.data() + open + 1, header.data() + header.size(), layout.count);
+    layout.utf32 = kind == 'U';
+    if (layout.utf32)
+    {
+        layout.itemBytes *= 4;
+    }
+    error = size.ec != std::errc() || count.ec != std::errc() || layout.itemBytes == 0
+            || !((kind == 'S' && (order == '|' || order == '<')) || (kind == 'U' && order == '<'));
+    return true;
+}
+
+/** Append one fixed-width string from a .npy array as a line, without its zero padding, and with any line breaks in it as spaces. */
+static void appendNpyString(std::vector<char> &lines, const char *item, const NpyStrings &layout)
+{
+    const size_t step = layout.utf32 ? 4 : 1;
+    size_t length = layout.itemBytes;
+    while (length >= step && std::memcmp(item + length - step, "\0\0\0\0", step) == 0)
+    {
+        length -= step;
+    }
+    for (size_t i = 0; i < length; i += step)
+    {
+        // Text events are ASCII or UTF-8, so UTF-32 code points past ASCII are rare -- encode them as UTF-8 anyway.
+        uint32_t c = (unsigned char)item[i];
+        if (layout.utf32)
+        {
+            c |= (uint32_t)(unsigned char)item[i + 1] << 8 | (uint32_t)(unsigned char)item[i + 2] << 16 | (uint32_t)(unsigned char)item[i + 3] << 24;
+        }
+        if (c == '\n' || c == '\r')
+        {
+            c = ' ';
+        }
+        if (c < 0x80 || !layout.utf32)
+        {
+            lines.push_back((char)c);
+        }
+        else if (c < 0x800)
+        {
+            lines.push_back((char)(0xC0 | c >> 6));
+            lines.push_back((char)(0x80 | (c & 0x3F)));
+        }
+        else if (c < 0x10000)
+        {
+            lines.push_back((char)(0xE0 | c >> 12));
+            lines.push_back((char)(0x80 | (c >> 6 & 0x3F)));
+            lines.push_back((char)(0x80 | (c & 0x3F)));
+        }
+        else
+        {
+            lines.push_back((char)(0xF0 | c >> 18));
+            lines.push_back((char)(0x80 | (c >> 12 & 0x3F)));
+            lines.push_back((char)(0x80 | (c >> 6 & 0x3F)));
+            lines.push_back((char)(0x80 | (c & 0x3F)));
+        }
+    }
+    lines.push_back('\n');
+}
+
+/**
+ * Split a round of whole lines into up to threadCount chunks that end at line breaks.
+ * Call work(chunkIndex, chunk) for each chunk on its own thread, then done(chunkCount) back on this thread.
+ */
+template <typename Work, typename Done>
+static void runRound(std::string_view round, int threadCount, Work &work, Done &done)
+{
+    std::vector<std::string_view> chunks;
+    size_t begin = 0;
+    const size_t target = round.size() / threadCount + 1;
+    while (begin < round.size())
+    {
+        size_t end = std::min(begin + target, round.size());
+        const size_t newline = round.find('\n', end - 1);
+        end = newline == std::string_view::npos ? round.size() : newline + 1;
+        chunks.push_back(round.substr(begin, end - begin));
+        begin = end;
+    }
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < chunks.size(); i++)
+    {
+        threads.emplace_back(work, i, chunks[i]);
+    }
+    if (!chunks.empty())
+    {
+        work((size_t)0, chunks[0]);
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+    done(chunks.size());
+}
+
+/**
+ * Read a file in rounds of whole lines, and hand each round to runRound().
+ * The file can be text with one event per line, or a .npy array of strings like an Open Ephys binary format text.npy,
+ * which reads as one line per string, in order.
+ * Return false if the file couldn't be read.
+ */
+template <typename Work, typename Done>
+static bool forEachRound(const char *path, size_t chunkBytes, int threadCount, Work work, Done done)
+{
+    FILE *file = std::fopen(path, "rb");
+    if (!file)
+    {
+        return false;
+    }
+
+    NpyStrings layout;
+    bool npyError = false;
+    if (readNpyHeader(file, layout, npyError))
+    {
+        if (npyError)
+        {
+            std::fprintf(stderr, "%s is not a 1-dimensional .npy array of strings\n", path);
+            std::fclose(file);
+            return false;
+        }
+
+        // Convert a round of fixed-width strings at a time to lines.
+        const size_t itemsPerRound = std::max(chunkBytes * threadCount / layout.itemBytes, (size_t)1);
+        std::vector<char> items(itemsPerRound * layout.itemBytes);
+        std::vector<char> lines;
+        size_t remaining = layout.count;
+        while (remaining > 0)
+        {
+            const size_t wanted = std::min(remaining, itemsPerRound);
+            const size_t got = std::fread(items.data(), layout.itemBytes, wanted, file);
+            lines.clear();
+            for (size_t i = 0; i < got; i++)
+            {
+                appendNpyString(lines, items.data() + i * layout.itemBytes, layout);
+            }
+            runRound(std::string_view(lines.data(), lines.size()), threadCount, work, done);
+            if (got < wanted)
+            {
+                break;
+            }
+            remaining -= got;
+        }
+        const bool ok = remaining == 0 && !std::ferror(file);
+        std::fclose(file);
+        return ok;
+    }
+
+    std::vector<char> buffer(chunkBytes * threadCount);
+    size_t carried = 0;
+    bool atEnd = false;
+    while (!atEnd)
+    {
+        carried += std::fread(buffer.data() + carried, 1, buffer.size() - carried, file);
+        atEnd = carried < buffer.size();
+
+        // Stop this round at the last full line, and carry the partial line to the next round.
+        size_t roundLength = carried;
+        if (!atEnd)
+        {
+            const size_t lastNewline = std::string_view(buffer.data(), carried).rfind('\n');
+            if (lastNewline == std::string_view::npos)
+            {
+                // One line longer than the whole buffer, make room for it and keep reading.
+                buffer.resize(buffer.size() * 2);
+                continue;
+            }
+            roundLength = lastNewline + 1;
+        }
+        runRound(std::string_view(buffer.data(), roundLength), threadCount, work, done);
+
+        std::memmove(buffer.data(), buffer.data() + roundLength, carried - roundLength);
+        carried -= roundLength;
+    }
+
+    const bool ok = !std::ferror(file);
+    std::fclose(file);
+    return ok;
+}
+
+/** Piecewise-linear map from client seconds to sample numbers for one stream, through smoothed sync pairs. */
+struct StreamFit
+{
+    std::vector<SyncPair> pairs;
+    std::vector<double> knotSecs;
+    std::vector<double> knotSamples;
+    size_t outliers = 0;
+
+    /** Drop outliers, then smooth each remaining pair with a fit over the window centered on it. */
+    void build(size_t windowSize)
+    {
+        std::sort(pairs.begin(), pairs.end(), [](const SyncPair &a, const SyncPair &b) { return a.softSecs < b.softSecs; });
+        if (pairs.size() < 2)
+        {
+            return;
+        }
+        const double nominalRate = (double)(pairs.back().sampleNumber - pairs.front().sampleNumber) / (pairs.back().softSecs - pairs.front().softSecs);
+
+        ClockModel screen;
+        screen.configure(windowSize, OUTLIER_THRESHOLD);
+        std::vector<SyncPair> accepted;
+        accepted.reserve(pairs.size());
+        for (const SyncPair &pair : pairs)
+        {
+            if (screen.addPair(pair.softSecs, pair.sampleNumber, nominalRate))
+            {
+                accepted.push_back(pair);
+            }
+        }
+        outliers = pairs.size() - accepted.size();
+
+        // Feed the fit a half window ahead, so the window is centered on each pair as we visit it.
+        ClockModel smooth;
+        smooth.configure(windowSize, 1e9);
+        const size_t lead = windowSize / 2;
+        size_t added = 0;
+        for (size_t i = 0; i < accepted.size(); i++)
+        {
+            while (added < accepted.size() && added <= i + lead)
+            {
+                smooth.addPair(accepted[added].softSecs, accepted[added].sampleNumber, nominalRate);
+                added++;
+            }
+            knotSecs.push_back(accepted[i].softSecs);
+            knotSamples.push_back(smooth.predict(accepted[i].softSecs));
+        }
+    }
+
+    bool usable() const
+    {
+        return knotSecs.size() >= 2;
+    }
+
+    /** Interpolate between the knots on either side, or extrapolate from the nearest two. */
+    double sampleNumber(double softSecs) const
+    {
+        size_t upper = std::upper_bound(knotSecs.begin(), knotSecs.end(), softSecs) - knotSecs.begin();
+        upper = std::min(std::max(upper, (size_t)1), knotSecs.size() - 1);
+        const size_t lower = upper - 1;
+        const double span = knotSecs[upper] - knotSecs[lower];
+        const double fraction = span > 0.0 ? (softSecs - knotSecs[lower]) / span : 0.0;
+        return knotSamples[lower] + fraction * (knotSamples[upper] - knotSamples[lower]);
+    }
+};
+
+/** Per-chunk results of the rewrite pass, combined on the main thread. */
+struct ChunkOutput
+{
+    std::string text;
+    uint64_t rewritten = 0;
+    uint64_t unmatched = 0;
+    double sumShift = 0.0;
+    double maxShift = 0.0;
+};
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        std::printf("Usage: %s inputFile outputFile [window] [threadCount] [chunkMegabytes]\n", argv[0]);
+        return 1;
+    }
+    const char *inputPath = argv[1];
+    const char *outputPath = argv[2];
+    const size_t windowSize = argc > 3 ? (size_t)std::atoi(argv[3]) : 16;
+    const int hardwareThreads = (int)std::thread::hardware_concurrency();
+    const int threadCount = argc > 4 ? std::atoi(argv[4]) : std::max(hardwareThreads, 1);
+    const size_t chunkBytes = (size_t)(argc > 5 ? std::atoi(argv[5]) : 4) << 20;
+    if (windowSize < 2 || threadCount < 1 || chunkBytes == 0)
+    {
+        std::printf("Usage: %s inputFile outputFile [window] [threadCount] [chunkMegabytes]\n", argv[0]);
+        return 1;
+    }
+
+    // First pass: collect sync pairs by stream.
+    std::vector<std::map<int, std::vector<SyncPair>>> chunkPairs(threadCount);
+    std::map<int, StreamFit> fits;
+    bool readOk = forEachRound(
+        inputPath, chunkBytes, threadCount,
+        [&](size_t chunkIndex, std::string_view chunk) {
+            std::map<int, std::vector<SyncPair>> &pairs = chunkPairs[chunkIndex];
+            forEachLine(chunk, [&](std::string_view line) {
+                int streamId;
+                SyncPair pair;
+                if (parseSyncPair(line, streamId, pair))
+                {
+                    pairs[streamId].push_back(pair);
+                }
+            });
+        },
+        [&](size_t chunkCount) {
+            for (size_t i = 0; i < chunkCount; i++)
+            {
+                for (auto &entry : chunkPairs[i])
+                {
+                    std::vector<SyncPair> &all = fits[entry.first].pairs;
+                    all.insert(all.end(), entry.second.begin(), entry.second.end());
+                }
+                chunkPairs[i].clear();
+            }
+        });
+    if (!readOk)
+    {
+        std::printf("Could not read %s\n", inputPath);
+        return 1;
+    }
+
+    for (auto &entry : fits)
+    {
+        entry.second.build(windowSize);
+        std::fprintf(stderr, "stream %d: %zu sync pairs, %zu outliers%s\n",
+                     entry.first, entry.second.pairs.size(), entry.second.outliers,
+                     entry.second.usable() ? "" : ", too few to realign");
+    }
+
+    // Events without a stream id belong to the only stream, if there's just one.
+    const StreamFit *onlyFit = fits.size() == 1 ? &fits.begin()->second : nullptr;
+
+    // Second pass: rewrite event sample numbers, writing chunks in order.
+    FILE *output = std::fopen(outputPath, "wb");
+    if (!output)
+    {
+        std::printf("Could not write %s\n", outputPath);
+        return 1;
+    }
+    std::vector<ChunkOutput> chunkOutputs(threadCount);
+    ChunkOutput totals;
+    readOk = forEachRound(
+        inputPath, chunkBytes, threadCount,
+        [&](size_t chunkIndex, std::string_view chunk) {
+            ChunkOutput &out = chunkOutputs[chunkIndex];
+            out.text.reserve(chunk.size() + chunk.size() / 8);
+            forEachLine(chunk, [&](std::string_view line) {
+                TimingSuffix suffix;
+                if (line.find(SYNC_PREFIX) != std::string_view::npos || !parseTimingSuffix(line, suffix))
+                {
+                    out.text.append(line);
+                    return;
+                }
+
+                const StreamFit *fit = onlyFit;
+                if (suffix.streamId != UNKNOWN_STREAM)
+                {
+                    auto found = fits.find(suffix.streamId);
+                    fit = found == fits.end() ? nullptr : &found->second;
+                }
+                if (!fit || !fit->usable())
+                {
+                    out.unmatched++;
+                    out.text.append(line);
+                    return;
+                }
+
+                const int64_t realigned = (int64_t)std::llround(fit->sampleNumber(suffix.softSecs));
+                const double shift = std::fabs((double)(realigned - suffix.sampleNumber));
+                out.rewritten++;
+                out.sumShift += shift;
+                out.maxShift = std::max(out.maxShift, shift);
+
+                char digits[24];
+                auto written = std::to_chars(digits, digits + sizeof(digits), realigned);
+                out.text.append(line.substr(0, suffix.sampleBegin));
+                out.text.append(digits, written.ptr - digits);
+                out.text.append(line.substr(suffix.sampleEnd));
+            });
+        },
+        [&](size_t chunkCount) {
+            for (size_t i = 0; i < chunkCount; i++)
+            {
+                ChunkOutput &out = chunkOutputs[i];
+                std::fwrite(out.text.data(), 1, out.text.size(), output);
+                totals.rewritten += out.rewritten;
+                totals.unmatched += out.unmatched;
+                totals.sumShift += out.sumShift;
+                totals.maxShift = std::max(totals.maxShift, out.maxShift);
+                out = ChunkOutput();
+            }
+        });
+    const bool writeOk = !std::ferror(output);
+    std::fclose(output);
+    if (!readOk || !writeOk)
+    {
+        std::printf("Could not realign %s to %s\n", inputPath, outputPath);
+        return 1;
+    }
+
+    std::fprintf(stderr, "realigned %llu events, mean shift %.3f samples, max shift %.0f samples, %llu events without usable sync pairs\n",
+                 (unsigned long long)totals.rewritten,
+                 totals.rewritten ? totals.sumShift / (double)totals.rewritten : 0.0,
+                 totals.maxShift,
+                 (unsigned long long)totals.unmatched);
+    return 0;
+}
@@ -0,0 +1,93 @@
+/** Print the header and records of a UDP Events binary sidecar file, as CSV.
+ *
+ * This is also a small example of reading sidecar files, using readSidecar() from SidecarFormat.h.
+ *
+ * Usage: SidecarReader sidecarFile [--summary]
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include "SidecarFormat.h"
+
+static const char *kindName(uint8_t kind)
+{
+    switch (kind)
+    {
+    case SIDECAR_SYNC_PAIR:
+        return "sync";
+    case SIDECAR_SYNC_OUTLIER:
+        return "outlier";
+    case SIDECAR_TTL_EVENT:
+        return "ttl";
+    case SIDECAR_TEXT_EVENT:
+        return "text";
+    default:
+        return "unknown";
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::printf("Usage: %s sidecarFile [--summary]\n", argv[0]);
+        return 1;
+    }
+    const bool summaryOnly = argc > 2 && std::strcmp(argv[2], "--summary") == 0;
+
+    std::ifstream file(argv[1], std::ios::binary);
+    if (!file)
+    {
+        std::printf("Could not open %s\n", argv[1]);
+        return 1;
+    }
+    std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    SidecarHeader header;
+    const SidecarRecord *records = nullptr;
+    if (!readSidecar(bytes.data(), bytes.size(), header, records))
+    {
+        std::printf("%s is not a version %d UDP Events sidecar file\n", argv[1], UDP_EVENTS_SIDECAR_VERSION);
+        return 1;
+    }
+
+    std::printf("# node %u, started %lld ms, %llu records\n", header.nodeId, (long long)header.startMillis, (unsigned long long)header.recordCount);
+    if (summaryOnly)
+    {
+        uint64_t kindCounts[5] = {};
+        for (uint64_t i = 0; i < header.recordCount; i++)
+        {
+            kindCounts[records[i].kind < 5 ? records[i].kind : 0]++;
+        }
+        for (uint8_t kind = 1; kind < 5; kind++)
+        {
+            std::printf("# %s: %llu\n", kindName(kind), (unsigned long long)kindCounts[kind]);
+        }
+        return 0;
+    }
+
+    std::printf("kind,stream,line,state,client_seconds,sample_number,receive_nanos,text_length,fit_sample_number,fit_samples_per_second,fit_rms,fit_pairs\n");
+    for (uint64_t i = 0; i < header.recordCount; i++)
+    {
+        const SidecarRecord &record = records[i];
+        std::printf("%s,%u,%u,%u,%.9f,%lld,%lld,%u,%.3f,%.6f,%.3f,%u\n",
+                    kindName(record.kind),
+                    (unsigned)record.streamId,
+                    (unsigned)record.line,
+                    (unsigned)record.state,
+                    record.clientSeconds,
+                    (long long)record.sampleNumber,
+                    (long long)record.receiveNanos,
+                    (unsigned)record.textLength,
+                    record.fitSampleNumber,
+                    record.fitSamplesPerSecond,
+                    record.fitResidualRms,
+                    record.fitPairCount);
+    }
+    return 0;
+}
@@ -0,0 +1,198 @@
+/** Compare handing soft events from the UDP thread to process() via SpscRing, vs the std::queue + lock it replaced.
+ *
+ * A producer thread pushes events as fast as it can, like run() during a burst of messages.
+ * A consumer thread drains events and spends a little time on each one, like process() calling addEvent().
+ * The locked queue is drained while holding the lock, which is how process() used to work.
+ *
+ * Usage: SoftEventRingBenchmark [eventCount] [nanosPerEvent]
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "SoftEvent.h"
+#include "SpscRing.h"
+
+/** The old way: std::queue guarded by a lock, drained with the lock held. */
+struct LockedQueue
+{
+    std::queue<SoftEvent> queue;
+    std::mutex lock;
+    size_t highWaterMark = 0;
+
+    bool push(const SoftEvent &event)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        queue.push(event);
+        highWaterMark = std::max(highWaterMark, queue.size());
+        return true;
+    }
+
+    size_t maxDepth()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return highWaterMark;
+    }
+
+    template <typename Visitor>
+    size_t drain(Visitor visit)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        size_t count = 0;
+        while (!queue.empty())
+        {
+            visit(queue.front());
+            queue.pop();
+            count++;
+        }
+        return count;
+    }
+};
+
+/** The new way: lock-free ring, drained in place. */
+struct RingQueue
+{
+    SpscRing<SoftEvent> ring{4096};
+
+    bool push(const SoftEvent &event)
+    {
+        return ring.push(event);
+    }
+
+    size_t maxDepth()
+    {
+        return ring.maxOccupancy();
+    }
+
+    template <typename Visitor>
+    size_t drain(Visitor visit)
+    {
+        size_t count = 0;
+        while (SoftEvent *event = ring.front())
+        {
+            visit(*event);
+            ring.pop();
+            count++;
+        }
+        return count;
+    }
+};
+
+/** Busy-wait to simulate per-event work in process(). */
+static void spinFor(int64_t nanos)
+{
+    const auto until = std::chrono::steady_clock::now() + std::chrono::nanoseconds(nanos);
+    while (std::chrono::steady_clock::now() < until)
+    {
+    }
+}
+
+struct BenchResult
+{
+    double seconds = 0.0;
+    int64_t pushNanosP50 = 0;
+    int64_t pushNanosP99 = 0;
+    int64_t pushNanosMax = 0;
+    uint64_t pushRetries = 0;
+    size_t maxDepth = 0;
+};
+
+template <typename Queue>
+static BenchResult runBenchmark(int eventCount, int64_t nanosPerEvent)
+{
+    Queue queue;
+    std::atomic<bool> producerDone{false};
+    std::vector<int64_t> pushNanos(eventCount);
+    uint64_t pushRetries = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    std::thread consumer([&]() {
+        size_t consumed = 0;
+        double checksum = 0.0;
+        while (consumed < (size_t)eventCount)
+        {
+            consumed += queue.drain([&](const SoftEvent &event) {
+                checksum += event.clientSeconds;
+                spinFor(nanosPerEvent);
+            });
+            if (producerDone.load() && consumed < (size_t)eventCount)
+            {
+                std::this_thread::yield();
+            }
+        }
+        if (checksum < 0)
+        {
+            std::printf("unexpected checksum %f\n", checksum);
+        }
+    });
+
+    std::thread producer([&]() {
+        SoftEvent event;
+        event.type = 1;
+        for (int i = 0; i < eventCount; i++)
+        {
+            event.clientSeconds = i;
+            const auto before = std::chrono::steady_clock::now();
+            while (!queue.push(event))
+            {
+                // The ring is full, so the consumer is behind.  A real producer would drop, here we retry to keep counts equal.
+                pushRetries++;
+                std::this_thread::yield();
+            }
+            const auto after = std::chrono::steady_clock::now();
+            pushNanos[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(after - before).count();
+        }
+        producerDone.store(true);
+    });
+
+    producer.join();
+    consumer.join();
+
+    BenchResult result;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::sort(pushNanos.begin(), pushNanos.end());
+    result.pushNanosP50 = pushNanos[eventCount / 2];
+    result.pushNanosP99 = pushNanos[(size_t)(eventCount * 0.99)];
+    result.pushNanosMax = pushNanos.back();
+    result.pushRetries = pushRetries;
+    result.maxDepth = queue.maxDepth();
+    return result;
+}
+
+static void report(const char *name, int eventCount, const BenchResult &result)
+{
+    std::printf("%-14s %12.0f %10lld %10lld %12lld %10llu %10zu\n",
+                name,
+                eventCount / result.seconds,
+                (long long)result.pushNanosP50,
+                (long long)result.pushNanosP99,
+                (long long)result.pushNanosMax,
+                (unsigned long long)result.pushRetries,
+                result.maxDepth);
+}
+
+int main(int argc, char **argv)
+{
+    const int eventCount = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    const int64_t nanosPerEvent = argc > 2 ? std::atoll(argv[2]) : 100;
+    if (eventCount <= 0)
+    {
+        std::printf("Usage: %s [eventCount] [nanosPerEvent]\n", argv[0]);
+        return 1;
+    }
+
+    std::printf("%d events, %lld ns of consumer work per event\n", eventCount, (long long)nanosPerEvent);
+    std::printf("%-14s %12s %10s %10s %12s %10s %10s\n", "queue", "events/s", "push p50", "push p99", "push max ns", "retries", "max depth");
+    report("locked queue", eventCount, runBenchmark<LockedQueue>(eventCount, nanosPerEvent));
+    report("spsc ring", eventCount, runBenchmark<RingQueue>(eventCount, nanosPerEvent));
+    return 0;
+}
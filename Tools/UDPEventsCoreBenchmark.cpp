@@ -0,0 +1,263 @@
+/** Microbenchmarks for the JUCE-free UDP Events core: message parsing, queue handoff, and soft timestamp conversion.
+ *
+ * Each benchmark runs several repetitions and reports the fastest and median time per operation.
+ * Results go to stdout as JSON so they can be saved and compared across builds, and a readable table goes to stderr.
+ *
+ * Usage: UDPEventsCoreBenchmark [iterations] [repetitions] > results.json
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ClockModel.h"
+#include "SoftEvent.h"
+#include "SpscRing.h"
+#include "SyncHistory.h"
+#include "TextArena.h"
+#include "UDPEventsParser.h"
+#include "UDPEventsProtocol.h"
+
+struct Result
+{
+    std::string name;
+    std::string unit;
+    double nanosMin = 0.0;
+    double nanosMedian = 0.0;
+};
+
+/** Run a benchmark body several times.  The body does some number of operations and returns how many. */
+static Result measure(const std::string &name, const std::string &unit, int repetitions, const std::function<uint64_t()> &body)
+{
+    std::vector<double> nanosPerOp;
+    for (int i = 0; i < repetitions; i++)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        const uint64_t operations = body();
+        const double nanos = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        nanosPerOp.push_back(nanos / (double)std::max<uint64_t>(operations, 1));
+    }
+    std::sort(nanosPerOp.begin(), nanosPerOp.end());
+    Result result;
+    result.name = name;
+    result.unit = unit;
+    result.nanosMin = nanosPerOp.front();
+    result.nanosMedian = nanosPerOp[nanosPerOp.size() / 2];
+    std::fprintf(stderr, "%-28s %10.1f %10.1f ns/%s\n", name.c_str(), result.nanosMin, result.nanosMedian, unit.c_str());
+    return result;
+}
+
+/** Append the usual header: type, client seconds, and 2 type-specific bytes, with 16-bit values in network byte order. */
+static void appendHeader(std::vector<char> &message, uint8_t type, double clientSeconds, uint8_t first, uint8_t second)
+{
+    message.push_back((char)type);
+    const size_t at = message.size();
+    message.resize(at + sizeof(clientSeconds));
+    std::memcpy(message.data() + at, &clientSeconds, sizeof(clientSeconds));
+    message.push_back((char)first);
+    message.push_back((char)second);
+}
+
+static std::vector<char> ttlMessage(double clientSeconds)
+{
+    std::vector<char> message;
+    appendHeader(message, SOFT_EVENT_TYPE_TTL, clientSeconds, 3, 1);
+    return message;
+}
+
+static std::vector<char> textMessage(double clientSeconds, size_t textLength)
+{
+    std::vector<char> message;
+    appendHeader(message, SOFT_EVENT_TYPE_TEXT, clientSeconds, (uint8_t)(textLength >> 8), (uint8_t)textLength);
+    message.insert(message.end(), textLength, 'x');
+    return message;
+}
+
+static std::vector<char> batchMessage(double clientSeconds, int recordCount)
+{
+    std::vector<char> message;
+    appendHeader(message, UDP_EVENTS_MESSAGE_TYPE_BATCH, clientSeconds, (uint8_t)(recordCount >> 8), (uint8_t)recordCount);
+    for (int i = 0; i < recordCount; i++)
+    {
+        std::vector<char> record = ttlMessage(clientSeconds + i * 0.001);
+        message.insert(message.end(), record.begin(), record.end());
+    }
+    return message;
+}
+
+/** Parse the same message over and over on one thread, draining the queue and releasing text like process() would. */
+static uint64_t parseRepeatedly(const std::vector<char> &message, int iterations)
+{
+    SpscRing<SoftEvent> queue(4096);
+    TextArena text(1 << 20);
+    UDPEventsStats stats;
+    UDPEventsParser parser(0, queue, text, stats);
+    uint64_t records = 0;
+    uint64_t releaseOffset = 0;
+    for (int i = 0; i < iterations; i++)
+    {
+        records += parser.parseMessage(message.data(), (int)message.size(), i);
+        if ((i & 255) == 255)
+        {
+            while (SoftEvent *event = queue.front())
+            {
+                releaseOffset = std::max(releaseOffset, event->textArenaEnd());
+                queue.pop();
+            }
+            text.releaseUpTo(releaseOffset);
+        }
+    }
+    return records;
+}
+
+/** Hand events from a producer thread to a consumer thread, like the receiver thread and process(). */
+static uint64_t handOff(int iterations)
+{
+    SpscRing<SoftEvent> queue(4096);
+    std::thread consumer([&]() {
+        int consumed = 0;
+        while (consumed < iterations)
+        {
+            while (queue.front())
+            {
+                queue.pop();
+                consumed++;
+            }
+            std::this_thread::yield();
+        }
+    });
+    SoftEvent event;
+    event.type = SOFT_EVENT_TYPE_TTL;
+    for (int i = 0; i < iterations; i++)
+    {
+        event.clientSeconds = i;
+        while (!queue.push(event))
+        {
+            std::this_thread::yield();
+        }
+    }
+    consumer.join();
+    return (uint64_t)iterations;
+}
+
+/** Fill a sync history with one estimate per second from a slightly fast client clock. */
+static void fillHistory(SyncHistory &history, size_t estimateCount, double sampleRate)
+{
+    history.configure(estimateCount);
+    ClockModel clockModel;
+    clockModel.configure(16, 5.0);
+    for (size_t i = 0; i < estimateCount; i++)
+    {
+        SyncEstimate estimate;
+        estimate.syncSoftSecs = 100.0 + (double)i;
+        estimate.syncLocalSampleNumber = 12345 + (int64_t)std::llround(estimate.syncSoftSecs * sampleRate * 1.00001);
+        estimate.syncLocalTimestamp = 1.0;
+        estimate.recordSoftTimestamp(estimate.syncSoftSecs, (float)sampleRate);
+        clockModel.addPair(estimate.syncSoftSecs, estimate.syncLocalSampleNumber, sampleRate);
+        estimate.recordClockFit(clockModel);
+        history.add(estimate);
+    }
+}
+
+/** Convert soft timestamps to sample numbers the way process() does: find the estimate, then convert with its fit. */
+static uint64_t convertTimestamps(const SyncHistory &history, const std::vector<double> &softSecs, int iterations, float sampleRate)
+{
+    int64_t checksum = 0;
+    for (int i = 0; i < iterations; i++)
+    {
+        const double secs = softSecs[i & (softSecs.size() - 1)];
+        const SyncEstimate *estimate = history.find(secs);
+        if (estimate)
+        {
+            checksum += estimate->softSampleNumber(secs, sampleRate);
+        }
+    }
+    if (checksum == 42)
+    {
+        std::fprintf(stderr, "unlikely checksum\n");
+    }
+    return (uint64_t)iterations;
+}
+
+static void printJson(const std::vector<Result> &results, int iterations, int repetitions)
+{
+    std::printf("{\n");
+    std::printf("  \"benchmark\": \"UDPEventsCore\",\n");
+    std::printf("  \"iterations\": %d,\n", iterations);
+    std::printf("  \"repetitions\": %d,\n", repetitions);
+    std::printf("  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const Result &result = results[i];
+        std::printf("    {\"name\": \"%s\", \"unit\": \"%s\", \"ns_per_op_min\": %.3f, \"ns_per_op_median\": %.3f, \"ops_per_second\": %.0f}%s\n",
+                    result.name.c_str(),
+                    result.unit.c_str(),
+                    result.nanosMin,
+                    result.nanosMedian,
+                    1e9 / result.nanosMedian,
+                    i + 1 < results.size() ? "," : "");
+    }
+    std::printf("  ]\n");
+    std::printf("}\n");
+}
+
+int main(int argc, char **argv)
+{
+    const int iterations = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    const int repetitions = argc > 2 ? std::atoi(argv[2]) : 5;
+    if (iterations <= 0 || repetitions <= 0)
+    {
+        std::printf("Usage: %s [iterations] [repetitions]\n", argv[0]);
+        return 1;
+    }
+
+    std::fprintf(stderr, "%-28s %10s %10s\n", "benchmark", "min", "median");
+    std::vector<Result> results;
+
+    // Parse throughput for each kind of message.
+    const std::vector<char> ttl = ttlMessage(123.456);
+    const std::vector<char> shortText = textMessage(123.456, 32);
+    const std::vector<char> longText = textMessage(123.456, 256);
+    const std::vector<char> batch = batchMessage(123.456, 16);
+    results.push_back(measure("parse_ttl", "message", repetitions, [&]() { return parseRepeatedly(ttl, iterations); }));
+    results.push_back(measure("parse_text_inline", "message", repetitions, [&]() { return parseRepeatedly(shortText, iterations); }));
+    results.push_back(measure("parse_text_arena", "message", repetitions, [&]() { return parseRepeatedly(longText, iterations); }));
+    results.push_back(measure("parse_batch_16_ttl", "record", repetitions, [&]() { return parseRepeatedly(batch, iterations / 16); }));
+
+    // Handoff between threads.
+    results.push_back(measure("queue_handoff", "event", repetitions, [&]() { return handOff(iterations); }));
+
+    // Timestamp conversion as the sync history grows, for recent events and for events anywhere in the history.
+    const float sampleRate = 30000.0f;
+    for (size_t estimateCount : {1, 16, 256, 4096, 65536})
+    {
+        SyncHistory history;
+        fillHistory(history, estimateCount, sampleRate);
+
+        std::vector<double> recent(4096);
+        std::vector<double> anywhere(4096);
+        std::mt19937 random(1);
+        std::uniform_real_distribution<double> fraction(0.0, 1.0);
+        for (size_t i = 0; i < recent.size(); i++)
+        {
+            recent[i] = 100.0 + (double)estimateCount - 1.0 + fraction(random);
+            anywhere[i] = 100.0 + (double)estimateCount * fraction(random);
+        }
+
+        const std::string suffix = "_" + std::to_string(estimateCount);
+        results.push_back(measure("convert_recent" + suffix, "event", repetitions, [&]() { return convertTimestamps(history, recent, iterations, sampleRate); }));
+        results.push_back(measure("convert_anywhere" + suffix, "event", repetitions, [&]() { return convertTimestamps(history, anywhere, iterations, sampleRate); }));
+    }
+
+    printJson(results, iterations, repetitions);
+    return 0;
+}
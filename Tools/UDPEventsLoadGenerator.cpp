@@ -0,0 +1,672 @@
+/** Drive the UDP Events receive path with load over loopback, and measure throughput, ack round trip time, and loss.
+ *
+ * Each client thread has its own socket and sends TTL or text messages at a steady rate, in bursts of back-to-back messages.
+ * Every message sets the ack request flag and carries the client's send time, so extended acks give a round trip time.
+ *
+ * By default this runs a headless server in the same process, with the same MessageReader and parser the plugin uses,
+ * and a consumer thread that drains the event queue once per block, like process().
+ * Loss is then exact: messages sent minus events that reached the consumer.
+ * The headless server also records latency for the receive, parse, and queue stages, and from kernel receive to the consumer,
+ * and prints percentiles for each step to stderr, so block size and queue choices can be checked against a latency budget.
+ * With --target, this sends to a running UDP Events instance instead, and estimates loss from acks,
+ * so set that instance's ACK to per message, coalesced, or on request.
+ *
+ * With --sweep, this doubles the rate after each step until messages are lost or the clients can't keep up,
+ * which gives a saturation curve.  Results go to stdout as CSV, one row per step.
+ *
+ * Usage: UDPEventsLoadGenerator [--target host:port] [--clients N] [--rate messagesPerSecond] [--burst N] [--text bytes]
+ *                               [--seconds S] [--sweep] [--max-rate messagesPerSecond]
+ *                               [--ack message|none|coalesced|request] [--block-ms N]
+ *                               [--queue N] [--overflow newest|oldest|text] [--rcvbuf kilobytes] [--busy-poll micros]
+ *                               [--rt-priority N] [--cpus list] [--backend ring|poll]
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MessageReader.h"
+#include "OverflowPolicy.h"
+#include "SoftEvent.h"
+#include "SpscRing.h"
+#include "TextArena.h"
+#include "ThreadUtils.h"
+#include "UDPEventsLatency.h"
+#include "UDPEventsProtocol.h"
+#include "UDPUtils.h"
+
+/** Same text storage the plugin uses for each receiver. */
+static const size_t TEXT_CAPACITY = 1 << 20;
+
+/** How long clients keep listening for acks after they stop sending. */
+static const std::chrono::milliseconds ACK_GRACE(200);
+
+/** Sweeps stop once more than this fraction of messages are lost. */
+static const double SWEEP_MAX_LOSS = 0.01;
+
+/** Sweeps also stop once clients send less than this fraction of the offered rate. */
+static const double SWEEP_MIN_SEND_FRACTION = 0.9;
+
+struct Options
+{
+    std::string target;
+    int clients = 1;
+    double rate = 10000.0;
+    int burst = 1;
+    int textBytes = 0;
+    double seconds = 2.0;
+    bool sweep = false;
+    double maxRate = 4000000.0;
+    UDPEventsAckMode ackMode = ACK_COALESCED;
+    int blockMillis = 10;
+    int queueLimit = 4096;
+    UDPEventsOverflowPolicy overflowPolicy = OVERFLOW_DROP_NEWEST;
+    int receiveBufferKilobytes = 0;
+    int busyPollMicros = 0;
+    int realtimePriority = 0;
+    unsigned long long cpuMask = 0;
+    bool allowRing = true;
+};
+
+/** Client seconds are from a steady clock, so round trip times are immune to system clock changes. */
+static double steadySeconds()
+{
+    static const auto epoch = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+static UdpAddress makeAddress(const std::string &host, unsigned short port)
+{
+    UdpAddress address;
+    std::memset(&address, 0, sizeof(address));
+    std::strncpy(address.hostName, host.c_str(), sizeof(address.hostName) - 1);
+    address.port = port;
+    udpHostNameToBin(&address);
+    return address;
+}
+
+/** The plugin's receive path without the GUI: one reader thread, and a consumer thread standing in for process(). */
+class HeadlessServer
+{
+public:
+    HeadlessServer(const Options &options)
+        : queue(softEventQueueSlots(options.queueLimit, options.overflowPolicy)), text(TEXT_CAPACITY), reader(0, options.ackMode, queue, text, stats, latency),
+          blockMillis(options.blockMillis),
+          receiveBufferBytes(options.receiveBufferKilobytes * 1024), busyPollMicros(options.busyPollMicros),
+          realtimePriority(options.realtimePriority), cpuMask(options.cpuMask), allowRing(options.allowRing)
+    {
+        // Same queue limit, overflow policy, and backpressure as a plugin receiver.
+        configureSoftEventQueue(queue, options.queueLimit, options.overflowPolicy);
+        reader.setOverflowPolicy(options.overflowPolicy);
+        reader.setBackpressureDepth(options.queueLimit / 2);
+    }
+
+    ~HeadlessServer()
+    {
+        stop();
+    }
+
+    /** Bind a loopback port chosen by the system and start the threads.  Return false if that didn't work. */
+    bool start(UdpAddress &address)
+    {
+        serverSocket = udpOpenSocket();
+        address = makeAddress("127.0.0.1", 0);
+        if (serverSocket < 0)
+        {
+            std::fprintf(stderr, "Could not open headless server socket: %s\n", udpErrorMessage());
+            return false;
+        }
+        if (receiveBufferBytes > 0 && udpSetReceiveBufferSize(serverSocket, receiveBufferBytes) < 0)
+        {
+            std::fprintf(stderr, "Could not set receive buffer to %d bytes: %s\n", receiveBufferBytes, udpErrorMessage());
+        }
+        if (busyPollMicros > 0 && udpEnableBusyPoll(serverSocket, busyPollMicros) < 0)
+        {
+            std::fprintf(stderr, "Could not busy poll for %d us: %s\n", busyPollMicros, udpErrorMessage());
+        }
+        if (udpBind(serverSocket, &address) < 0)
+        {
+            std::fprintf(stderr, "Could not bind headless server socket: %s\n", udpErrorMessage());
+            return false;
+        }
+        std::fprintf(stderr, "Headless server receive buffer is %d bytes\n", udpGetReceiveBufferSize(serverSocket));
+        udpGetAddress(serverSocket, &address);
+        if (!reader.prepare(serverSocket, allowRing))
+        {
+            std::fprintf(stderr, "Headless server will use its own receive timestamps: %s\n", udpErrorMessage());
+        }
+        std::fprintf(stderr, "Headless server receives with %s\n", reader.usesRing() ? "io_uring" : "poll and batch reads");
+
+        readerThread = std::thread([this]() {
+            applyThreadOptions();
+            while (!shouldStop.load(std::memory_order_relaxed))
+            {
+                reader.readBatch(-1);
+                if (realtimePriority > 0)
+                {
+                    relockReceiveBuffers();
+                }
+            }
+        });
+        processThread = std::thread([this]() {
+            uint64_t releaseOffset = 0;
+            while (!shouldStop.load(std::memory_order_relaxed))
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(blockMillis));
+                uint64_t drained = 0;
+                while (SoftEvent *event = queue.front())
+                {
+                    latency.record(LATENCY_QUEUE, UDPEventsLatency::nowNanos() - event->stageNanos);
+                    latency.record(LATENCY_TOTAL, udpSystemTimeNanos() - event->receiveNanos);
+                    releaseOffset = std::max(releaseOffset, event->textArenaEnd());
+                    drained++;
+                    queue.pop();
+                }
+                text.releaseUpTo(releaseOffset);
+                consumed.fetch_add(drained, std::memory_order_relaxed);
+            }
+        });
+        return true;
+    }
+
+    void stop()
+    {
+        shouldStop.store(true);
+        reader.wake();
+        if (readerThread.joinable())
+        {
+            readerThread.join();
+        }
+        if (processThread.joinable())
+        {
+            processThread.join();
+        }
+        if (serverSocket >= 0)
+        {
+            udpCloseSocket(serverSocket);
+            serverSocket = -1;
+        }
+    }
+
+    /** Latency histograms for the stages the headless server has: receive, parse, queue, and total to the consumer. */
+    UDPEventsLatency &getLatency()
+    {
+        return latency;
+    }
+
+    /** How many messages the kernel dropped before the reader got to them, where the system reports it. */
+    uint64_t kernelDrops() const
+    {
+        return stats.get(STAT_KERNEL_DROPS);
+    }
+
+    /** How many events reached the consumer so far. */
+    uint64_t consumedCount() const
+    {
+        return consumed.load(std::memory_order_relaxed);
+    }
+
+    /** How many events were dropped because the queue was full, or by the overflow policy. */
+    uint64_t queueOverflows() const
+    {
+        return queue.overflowCount() + stats.get(STAT_QUEUE_DISCARDED_TTL) + stats.get(STAT_QUEUE_DISCARDED_TEXT);
+    }
+
+private:
+    /** Same thread options as a plugin receiver, applied from the reader thread. */
+    void applyThreadOptions()
+    {
+        if (realtimePriority > 0)
+        {
+            if (threadSetRealtimePriority(realtimePriority) < 0)
+            {
+                std::fprintf(stderr, "Could not get real-time priority %d: %s\n", realtimePriority, threadErrorMessage());
+            }
+            lockedReceiveBuffers = reader.getReceiveBuffers(lockedReceiveBytes);
+            if (threadLockMemory(lockedReceiveBuffers, lockedReceiveBytes) < 0
+                || threadLockMemory(queue.data(), queue.capacity() * sizeof(SoftEvent)) < 0
+                || threadLockMemory(text.data(), text.capacity()) < 0)
+            {
+                std::fprintf(stderr, "Could not lock headless server buffers in memory: %s\n", threadErrorMessage());
+            }
+        }
+        if (cpuMask != 0 && threadSetAffinity(cpuMask) < 0)
+        {
+            std::fprintf(stderr, "Could not set CPU mask 0x%llx: %s\n", cpuMask, threadErrorMessage());
+        }
+        char scheduling[256];
+        threadDescribeScheduling(scheduling, sizeof(scheduling));
+        std::fprintf(stderr, "Headless server reader thread has %s\n", scheduling);
+    }
+
+    /** Lock the reader's receive buffers again if it swapped them, like when it falls back from io_uring. */
+    void relockReceiveBuffers()
+    {
+        size_t receiveBytes = 0;
+        const char *receiveBuffers = reader.getReceiveBuffers(receiveBytes);
+        if (receiveBuffers == lockedReceiveBuffers && receiveBytes == lockedReceiveBytes)
+        {
+            return;
+        }
+        if (threadLockMemory(receiveBuffers, receiveBytes) < 0)
+        {
+            std::fprintf(stderr, "Could not lock new headless server receive buffers in memory: %s\n", threadErrorMessage());
+        }
+        lockedReceiveBuffers = receiveBuffers;
+        lockedReceiveBytes = receiveBytes;
+    }
+
+    SpscRing<SoftEvent> queue;
+    TextArena text;
+    UDPEventsStats stats;
+    UDPEventsLatency latency;
+    MessageReader reader;
+    const int blockMillis;
+    const int receiveBufferBytes;
+    const int busyPollMicros;
+    const int realtimePriority;
+    const unsigned long long cpuMask;
+    const bool allowRing;
+    int serverSocket = -1;
+    const char *lockedReceiveBuffers = nullptr;
+    size_t lockedReceiveBytes = 0;
+    std::thread readerThread;
+    std::thread processThread;
+    std::atomic<bool> shouldStop{false};
+    std::atomic<uint64_t> consumed{0};
+};
+
+struct ClientStats
+{
+    uint64_t sent = 0;
+    uint64_t sendErrors = 0;
+    uint64_t acks = 0;
+    uint64_t ackedMessages = 0;
+    uint64_t backpressureAcks = 0;
+    std::vector<double> rttMicros;
+};
+
+/** Read any acks waiting on a client socket, waiting up to the given time for the first one. */
+static void readAcks(int s, int timeoutMillis, UdpMessage *replies, ClientStats &stats)
+{
+    if (!udpAwaitMessage(s, timeoutMillis))
+    {
+        return;
+    }
+    const int replyCount = udpReceiveBatch(s, replies, UDP_MAX_BATCH_SIZE);
+    const double now = steadySeconds();
+    for (int i = 0; i < replyCount; i++)
+    {
+        const char *reply = replies[i].buffer;
+        if (replies[i].bytesRead == UDP_EVENTS_EXTENDED_ACK_LENGTH)
+        {
+            double clientSeconds;
+            std::memcpy(&clientSeconds, reply + 8, sizeof(clientSeconds));
+            stats.acks++;
+            stats.ackedMessages += ((uint8_t)reply[16] << 8) | (uint8_t)reply[17];
+            stats.backpressureAcks += (reply[26] & UDP_EVENTS_ACK_FLAG_BACKPRESSURE) ? 1 : 0;
+            stats.rttMicros.push_back((now - clientSeconds) * 1e6);
+        }
+        else if (replies[i].bytesRead == UDP_EVENTS_ACK_LENGTH)
+        {
+            // Original acks don't say which message they're for, so just count them.
+            stats.acks++;
+            stats.ackedMessages++;
+        }
+    }
+}
+
+/** Send bursts of messages at the given rate until the time is up, reading acks in between. */
+static void runClient(const Options &options, const UdpAddress &server, double rate, ClientStats &stats)
+{
+    const int s = udpOpenSocket();
+    if (s < 0)
+    {
+        std::fprintf(stderr, "Could not open client socket: %s\n", udpErrorMessage());
+        return;
+    }
+
+    // Build one burst of messages up front, and just update client seconds before each send.
+    const int burst = std::min(std::max(options.burst, 1), UDP_MAX_BATCH_SIZE);
+    const int messageLength = UDP_EVENTS_HEADER_LENGTH + options.textBytes;
+    std::vector<char> burstBuffers(burst * messageLength, 'x');
+    UdpMessage messages[UDP_MAX_BATCH_SIZE];
+    for (int i = 0; i < burst; i++)
+    {
+        char *message = burstBuffers.data() + i * messageLength;
+        if (options.textBytes > 0)
+        {
+            message[0] = (char)(SOFT_EVENT_TYPE_TEXT | UDP_EVENTS_FLAG_ACK_REQUESTED);
+            message[9] = (char)(options.textBytes >> 8);
+            message[10] = (char)(options.textBytes & 0xFF);
+        }
+        else
+        {
+            message[0] = (char)(SOFT_EVENT_TYPE_TTL | UDP_EVENTS_FLAG_ACK_REQUESTED);
+            message[9] = 1;
+            message[10] = (char)(i & 1);
+        }
+        messages[i].buffer = message;
+        messages[i].bufferLength = messageLength;
+        messages[i].address = server;
+    }
+
+    std::vector<char> replyBuffers(UDP_MAX_BATCH_SIZE * UDP_EVENTS_EXTENDED_ACK_LENGTH);
+    UdpMessage replies[UDP_MAX_BATCH_SIZE];
+    for (int i = 0; i < UDP_MAX_BATCH_SIZE; i++)
+    {
+        replies[i].buffer = replyBuffers.data() + i * UDP_EVENTS_EXTENDED_ACK_LENGTH;
+        replies[i].bufferLength = UDP_EVENTS_EXTENDED_ACK_LENGTH;
+    }
+
+    const double interval = burst / rate;
+    const double start = steadySeconds();
+    const double end = start + options.seconds;
+    double nextBurst = start;
+    while (true)
+    {
+        double now = steadySeconds();
+        if (now >= end)
+        {
+            break;
+        }
+        if (now >= nextBurst)
+        {
+            for (int i = 0; i < burst; i++)
+            {
+                std::memcpy(messages[i].buffer + 1, &now, sizeof(now));
+            }
+            const int sent = udpSendBatch(s, messages, burst);
+            if (sent < burst)
+            {
+                stats.sendErrors += burst - std::max(sent, 0);
+            }
+            stats.sent += std::max(sent, 0);
+            nextBurst += interval;
+            continue;
+        }
+
+        // Read acks while waiting for the next burst, sleeping only if there's at least a millisecond to spare.
+        // Otherwise yield, so clients don't starve the server when they share a core.
+        if (nextBurst - now >= 0.002)
+        {
+            readAcks(s, 1, replies, stats);
+        }
+        else
+        {
+            readAcks(s, 0, replies, stats);
+            std::this_thread::yield();
+        }
+    }
+
+    const auto graceEnd = std::chrono::steady_clock::now() + ACK_GRACE;
+    while (std::chrono::steady_clock::now() < graceEnd)
+    {
+        readAcks(s, 10, replies, stats);
+    }
+    udpCloseSocket(s);
+}
+
+static double percentile(std::vector<double> &values, double fraction)
+{
+    if (values.empty())
+    {
+        return 0.0;
+    }
+    const size_t index = std::min(values.size() - 1, (size_t)(fraction * (double)values.size()));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+struct StepResult
+{
+    double sentPerSecond = 0.0;
+    double lossFraction = 0.0;
+};
+
+/** Run all clients at the given total rate, print one CSV row, and return the achieved send rate and loss. */
+static StepResult runStep(const Options &options, const UdpAddress &server, HeadlessServer *headless, double rate)
+{
+    const uint64_t consumedBefore = headless ? headless->consumedCount() : 0;
+    const uint64_t overflowsBefore = headless ? headless->queueOverflows() : 0;
+    const uint64_t kernelDropsBefore = headless ? headless->kernelDrops() : 0;
+    if (headless)
+    {
+        headless->getLatency().clear();
+    }
+
+    std::vector<ClientStats> stats(options.clients);
+    std::vector<std::thread> clients;
+    for (int i = 0; i < options.clients; i++)
+    {
+        clients.emplace_back(runClient, std::cref(options), std::cref(server), rate / options.clients, std::ref(stats[i]));
+    }
+    for (std::thread &client : clients)
+    {
+        client.join();
+    }
+
+    ClientStats total;
+    for (ClientStats &client : stats)
+    {
+        total.sent += client.sent;
+        total.sendErrors += client.sendErrors;
+        total.acks += client.acks;
+        total.ackedMessages += client.ackedMessages;
+        total.backpressureAcks += client.backpressureAcks;
+        total.rttMicros.insert(total.rttMicros.end(), client.rttMicros.begin(), client.rttMicros.end());
+    }
+
+    // Headless, count events that made it all the way to the consumer.  Otherwise, count what was acked.
+    uint64_t received = total.ackedMessages;
+    uint64_t overflows = 0;
+    uint64_t kernelDrops = 0;
+    if (headless)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2 * options.blockMillis));
+        received = headless->consumedCount() - consumedBefore;
+        overflows = headless->queueOverflows() - overflowsBefore;
+        kernelDrops = headless->kernelDrops() - kernelDropsBefore;
+
+        // Report where time went in the server, for this step only.
+        std::fprintf(stderr, "%.0f messages/s latency (us):", rate);
+        for (int i = 0; i < LATENCY_STAGE_COUNT; i++)
+        {
+            const LatencyHistogram &histogram = headless->getLatency().get((UDPEventsLatencyStage)i);
+            if (histogram.count() > 0)
+            {
+                std::fprintf(stderr, " %s p50 %.1f p99 %.1f p99.9 %.1f;",
+                             UDPEventsLatency::name((UDPEventsLatencyStage)i),
+                             histogram.percentile(0.5) / 1000.0,
+                             histogram.percentile(0.99) / 1000.0,
+                             histogram.percentile(0.999) / 1000.0);
+            }
+        }
+        std::fprintf(stderr, "\n");
+    }
+
+    StepResult result;
+    result.sentPerSecond = (double)total.sent / options.seconds;
+    result.lossFraction = total.sent > 0 ? 1.0 - std::min(1.0, (double)received / (double)total.sent) : 0.0;
+    std::printf("%.0f,%.0f,%.0f,%.4f,%llu,%llu,%llu,%.1f,%.1f,%.1f,%llu,%llu\n",
+                rate,
+                result.sentPerSecond,
+                (double)received / options.seconds,
+                100.0 * result.lossFraction,
+                (unsigned long long)total.sendErrors,
+                (unsigned long long)overflows,
+                (unsigned long long)total.acks,
+                percentile(total.rttMicros, 0.5),
+                percentile(total.rttMicros, 0.99),
+                percentile(total.rttMicros, 0.999),
+                (unsigned long long)total.backpressureAcks,
+                (unsigned long long)kernelDrops);
+    std::fflush(stdout);
+    return result;
+}
+
+static bool parseAckMode(const char *name, UDPEventsAckMode &mode)
+{
+    if (std::strcmp(name, "message") == 0)
+        mode = ACK_PER_MESSAGE;
+    else if (std::strcmp(name, "none") == 0)
+        mode = ACK_NONE;
+    else if (std::strcmp(name, "coalesced") == 0)
+        mode = ACK_COALESCED;
+    else if (std::strcmp(name, "request") == 0)
+        mode = ACK_ON_REQUEST;
+    else
+        return false;
+    return true;
+}
+
+static bool parseOverflowPolicy(const char *name, UDPEventsOverflowPolicy &policy)
+{
+    if (std::strcmp(name, "newest") == 0)
+        policy = OVERFLOW_DROP_NEWEST;
+    else if (std::strcmp(name, "oldest") == 0)
+        policy = OVERFLOW_DROP_OLDEST;
+    else if (std::strcmp(name, "text") == 0)
+        policy = OVERFLOW_DROP_TEXT_FIRST;
+    else
+        return false;
+    return true;
+}
+
+static bool parseBackend(const char *name, bool &allowRing)
+{
+    if (std::strcmp(name, "ring") == 0)
+        allowRing = true;
+    else if (std::strcmp(name, "poll") == 0)
+        allowRing = false;
+    else
+        return false;
+    return true;
+}
+
+static bool parseOptions(int argc, char **argv, Options &options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string name = argv[i];
+        if (name == "--sweep")
+        {
+            options.sweep = true;
+            continue;
+        }
+        if (i + 1 >= argc)
+        {
+            return false;
+        }
+        const char *value = argv[++i];
+        if (name == "--target")
+            options.target = value;
+        else if (name == "--clients")
+            options.clients = std::atoi(value);
+        else if (name == "--rate")
+            options.rate = std::atof(value);
+        else if (name == "--burst")
+            options.burst = std::atoi(value);
+        else if (name == "--text")
+            options.textBytes = std::atoi(value);
+        else if (name == "--seconds")
+            options.seconds = std::atof(value);
+        else if (name == "--max-rate")
+            options.maxRate = std::atof(value);
+        else if (name == "--block-ms")
+            options.blockMillis = std::atoi(value);
+        else if (name == "--queue")
+            options.queueLimit = std::atoi(value);
+        else if (name == "--rcvbuf")
+            options.receiveBufferKilobytes = std::atoi(value);
+        else if (name == "--busy-poll")
+            options.busyPollMicros = std::atoi(value);
+        else if (name == "--rt-priority")
+            options.realtimePriority = std::atoi(value);
+        else if (name == "--cpus")
+        {
+            if (!threadParseCpuList(value, &options.cpuMask))
+                return false;
+        }
+        else if (name == "--ack")
+        {
+            if (!parseAckMode(value, options.ackMode))
+                return false;
+        }
+        else if (name == "--overflow")
+        {
+            if (!parseOverflowPolicy(value, options.overflowPolicy))
+                return false;
+        }
+        else if (name == "--backend")
+        {
+            if (!parseBackend(value, options.allowRing))
+                return false;
+        }
+        else
+            return false;
+    }
+    return options.clients > 0 && options.rate > 0.0 && options.burst > 0 && options.seconds > 0.0 && options.blockMillis > 0 && options.queueLimit > 0 && options.textBytes >= 0 && UDP_EVENTS_HEADER_LENGTH + options.textBytes <= UDP_MAX_MESSAGE_LENGTH;
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parseOptions(argc, argv, options))
+    {
+        std::printf("Usage: %s [--target host:port] [--clients N] [--rate messagesPerSecond] [--burst N] [--text bytes]\n"
+                    "       [--seconds S] [--sweep] [--max-rate messagesPerSecond] [--ack message|none|coalesced|request] [--block-ms N]\n"
+                    "       [--queue N] [--overflow newest|oldest|text] [--rcvbuf kilobytes] [--busy-poll micros]\n"
+                    "       [--rt-priority N] [--cpus list] [--backend ring|poll]\n",
+                    argv[0]);
+        return 1;
+    }
+
+    UdpAddress server;
+    HeadlessServer *headless = nullptr;
+    HeadlessServer headlessServer(options);
+    if (options.target.empty())
+    {
+        if (!headlessServer.start(server))
+        {
+            return 1;
+        }
+        headless = &headlessServer;
+        std::fprintf(stderr, "Headless server on 127.0.0.1 port %u\n", (unsigned)server.port);
+    }
+    else
+    {
+        const size_t colon = options.target.rfind(':');
+        if (colon == std::string::npos)
+        {
+            std::printf("Target should look like host:port, not %s\n", options.target.c_str());
+            return 1;
+        }
+        server = makeAddress(options.target.substr(0, colon), (unsigned short)std::atoi(options.target.c_str() + colon + 1));
+    }
+
+    std::fprintf(stderr, "%d clients, bursts of %d, %s messages, %.1f s per step\n",
+                 options.clients, options.burst, options.textBytes > 0 ? (std::to_string(options.textBytes) + " byte text").c_str() : "TTL", options.seconds);
+    std::printf("offered_per_s,sent_per_s,received_per_s,loss_percent,send_errors,queue_overflows,acks,rtt_p50_us,rtt_p99_us,rtt_p999_us,backpressure_acks,kernel_drops\n");
+
+    double rate = options.rate;
+    while (true)
+    {
+        const StepResult result = runStep(options, server, headless, rate);
+        if (!options.sweep || result.lossFraction > SWEEP_MAX_LOSS || result.sentPerSecond < SWEEP_MIN_SEND_FRACTION * rate || rate * 2.0 > options.maxRate)
+        {
+            break;
+        }
+        rate *= 2.0;
+    }
+
+    headlessServer.stop();
+    return 0;
+}
@@ -0,0 +1,92 @@
+/** Ask a running UDP Events instance for its stats, and print each one as name=value.
+ *
+ * This sends one stats request (message type 0x04) and waits up to a second for the reply.
+ * Stats this tool doesn't know about, from a newer plugin, print with their index instead of a name.
+ * Exit status is 0 if a reply arrived.
+ *
+ * Usage: UDPEventsStatsQuery [host] [port]
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "UDPEventsProtocol.h"
+#include "UDPEventsStats.h"
+#include "UDPUtils.h"
+
+int main(int argc, char **argv)
+{
+    const char *hostName = argc > 1 ? argv[1] : "127.0.0.1";
+    const unsigned short port = (unsigned short)(argc > 2 ? std::atoi(argv[2]) : 12345);
+
+    UdpAddress server;
+    std::memset(&server, 0, sizeof(server));
+    std::strncpy(server.hostName, hostName, sizeof(server.hostName) - 1);
+    server.port = port;
+    udpHostNameToBin(&server);
+
+    int s = udpOpenSocket();
+    if (s < 0)
+    {
+        std::printf("Could not open socket: %s\n", udpErrorMessage());
+        return 1;
+    }
+
+    // The request is just a type byte and a client timestamp, which comes back in the reply.
+    char request[9];
+    request[0] = (char)UDP_EVENTS_MESSAGE_TYPE_STATS;
+    const double clientSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    std::memcpy(request + 1, &clientSeconds, sizeof(clientSeconds));
+    if (udpSendTo(s, &server, request, sizeof(request)) != (int)sizeof(request))
+    {
+        std::printf("Could not send stats request to %s port %u: %s\n", hostName, (unsigned)port, udpErrorMessage());
+        udpCloseSocket(s);
+        return 1;
+    }
+
+    // Leave room for a reply from a newer plugin with more stats than this tool knows about.
+    char reply[UDP_MAX_MESSAGE_LENGTH];
+    UdpAddress from;
+    int bytesRead = udpAwaitMessage(s, 1000) ? udpReceiveFrom(s, &from, reply, sizeof(reply)) : 0;
+    udpCloseSocket(s);
+    if (bytesRead < UDP_EVENTS_STATS_REPLY_HEADER_LENGTH || (uint8_t)reply[0] != UDP_EVENTS_MESSAGE_TYPE_STATS)
+    {
+        std::printf("No stats reply from %s port %u\n", hostName, (unsigned)port);
+        return 1;
+    }
+
+    const int version = (uint8_t)reply[1];
+    int statCount = ((uint8_t)reply[2] << 8) | (uint8_t)reply[3];
+    double echoedSeconds;
+    int64_t serverMillis;
+    std::memcpy(&echoedSeconds, reply + 4, sizeof(echoedSeconds));
+    std::memcpy(&serverMillis, reply + 12, sizeof(serverMillis));
+    const double roundTripMillis = 1000.0 * (std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count() - echoedSeconds);
+
+    // Don't trust the declared count past the end of what we actually received.
+    if (statCount > (bytesRead - UDP_EVENTS_STATS_REPLY_HEADER_LENGTH) / 8)
+    {
+        statCount = (bytesRead - UDP_EVENTS_STATS_REPLY_HEADER_LENGTH) / 8;
+    }
+
+    std::printf("version=%d\n", version);
+    std::printf("server_millis=%lld\n", (long long)serverMillis);
+    std::printf("round_trip_millis=%.3f\n", roundTripMillis);
+    for (int i = 0; i < statCount; i++)
+    {
+        uint64_t value;
+        std::memcpy(&value, reply + UDP_EVENTS_STATS_REPLY_HEADER_LENGTH + 8 * i, sizeof(value));
+        if (i < STAT_COUNT)
+        {
+            std::printf("%s=%llu\n", UDPEventsStats::name((UDPEventsStat)i), (unsigned long long)value);
+        }
+        else
+        {
+            std::printf("stat_%d=%llu\n", i, (unsigned long long)value);
+        }
+    }
+    return 0;
+}
@@ -115,3 +115,31 @@ with zmq.Context() as zmq_context:
                 # Replies can stack up in the socket queue until we read them.
                 print("UDP TTL on reply: " + double_bytes_to_str(udp_socket.recvfrom(256)[0]))
                 print("UDP TTL off reply: " + double_bytes_to_str(udp_socket.recvfrom(256)[0]))
+
+                # Send a burst of events together in one batch message, with one reply for the whole batch.
+                # Each record in the batch has the same format as a standalone TTL or text message.
+                batch_records = []
+                for edge in range(4):
+                    udp_batch_ttl = bytearray(11)
+                    struct.pack_into('B', udp_batch_ttl, 0, 1)
+                    struct.pack_into('d', udp_batch_ttl, 1, up_secs())
+                    struct.pack_into('B', udp_batch_ttl, 9, extra_line_number)
+                    struct.pack_into('B', udp_batch_ttl, 10, (edge + 1) % 2)
+                    batch_records.append(udp_batch_ttl)
+
+                batch_text_bytes = b"Four quick edges."
+                udp_batch_text = bytearray(11 + len(batch_text_bytes))
+                struct.pack_into('B', udp_batch_text, 0, 2)
+                struct.pack_into('d', udp_batch_text, 1, up_secs())
+                struct.pack_into('H', udp_batch_text, 9, socket.htons(len(batch_text_bytes)))
+                udp_batch_text[11:11+len(batch_text_bytes)] = batch_text_bytes
+                batch_records.append(udp_batch_text)
+
+                udp_batch_header = bytearray(11)
+                struct.pack_into('B', udp_batch_header, 0, 3)
+                struct.pack_into('d', udp_batch_header, 1, up_secs())
+                struct.pack_into('H', udp_batch_header, 9, socket.htons(len(batch_records)))
+                udp_batch_message = udp_batch_header + b"".join(batch_records)
+
+                bytes_sent = udp_socket.sendto(udp_batch_message, udp_destination)
+                print("UDP batch reply: " + double_bytes_to_str(udp_socket.recvfrom(256)[0]))